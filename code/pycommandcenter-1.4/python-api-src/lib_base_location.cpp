@@ -8,9 +8,13 @@ void define_base_location(py::module & m)
         .def_property_readonly("geysers", &BaseLocation::getGeysers, "List of geysers at base location (List of units)")
         .def_property_readonly("minerals", &BaseLocation::getMinerals, "List of mineral fields at base location (List of unit), Note: also returns the empty mineralfields")
         //.def_property_readonly("mineral_fields", &BaseLocation::getMinerals, "Alias for minerals in order to differentiate from harvested minerals") // This just did the same thing as minerals (above) removed to avoid confusion
+        .def_property_readonly("base_id", &BaseLocation::getBaseId, "Index of the base location in BaseLocationManager.base_locations, and its row and column in BaseLocationManager.base_distance_matrix")
+        .def_property_readonly("remaining_minerals", &BaseLocation::getRemainingMinerals, "Minerals left in the mineral fields of the base location, as they were when last seen")
+        .def_property_readonly("remaining_gas", &BaseLocation::getRemainingGas, "Gas left in the geysers of the base location, as they were when last seen")
         .def_property_readonly("is_start_location", &BaseLocation::isStartLocation, "True if the base location is a start location, False otherwise")
         .def_property_readonly("depot_position", &BaseLocation::getDepotPosition, "A suitable position for building a town hall (Command Center, Hatchery or Nexus), defined as a : class :`library.Point2DI`.")
         .def_property_readonly("position", &BaseLocation::getPosition, "The position of the center of the BaseLocation, defined as a :class:`library.Point2D`.")
+        .def_property_readonly("region", &BaseLocation::getRegion, py::return_value_policy::reference, "The :class:`library.Region` the depot position of the BaseLocation lies in")
         .def("get_ground_distance", py::overload_cast<const CCPosition &>(&BaseLocation::getGroundDistance, py::const_))
         .def("get_ground_distance", py::overload_cast<const CCTilePosition &>(&BaseLocation::getGroundDistance, py::const_))
         .def("is_occupied_by_player", &BaseLocation::isOccupiedByPlayer, "player constant"_a, "If the baselocation is occupied by the provided player. See :ref:`playerconstants` for more information")
@@ -20,7 +24,21 @@ void define_base_location(py::module & m)
     py::class_<BaseLocationManager>(m, "BaseLocationManager")
         .def_property_readonly("base_locations", &BaseLocationManager::getBaseLocations, py::return_value_policy::reference, "A list of all :class:`library.BaseLocation` on the current map")
         .def_property_readonly("starting_base_locations", &BaseLocationManager::getStartingBaseLocations, py::return_value_policy::reference, "A list of all :class:`library.BaseLocation` on the current map which a player started at, indexed by Player constant(see :ref:`playerconstants`).")
+        .def_property("ground_clustering", &BaseLocationManager::getGroundClustering, &BaseLocationManager::setGroundClustering, "If True, minerals and geysers are only grouped into the same base location if they can be reached from each other over the ground, which keeps bases on either side of a cliff apart. Off by default, and has to be set before the game starts")
         .def("get_occupied_base_locations", &BaseLocationManager::getOccupiedBaseLocations, py::return_value_policy::reference, "player_constant"_a)
         .def("get_player_starting_base_location", &BaseLocationManager::getPlayerStartingBaseLocation, py::return_value_policy::copy, "player_constant"_a, "Returns the :class:`library.BaseLocation` that provided :ref:`playerconstants` started at.")
-        .def("get_next_expansion", &BaseLocationManager::getNextExpansion, py::return_value_policy::copy, "player_constant"_a, "Returns the :class:`library.BaseLocation` that is closest to the startlocation of provided :ref:`playerconstants` that is possible to expand to.");
+        .def("get_next_expansion", &BaseLocationManager::getNextExpansion, py::return_value_policy::copy, "player_constant"_a, "Returns the :class:`library.BaseLocation` that is closest to the startlocation of provided :ref:`playerconstants` that is possible to expand to.")
+        .def("get_base_location", py::overload_cast<const CCPosition &>(&BaseLocationManager::getBaseLocationAt, py::const_), py::return_value_policy::reference, "point2d"_a, "Returns the :class:`library.BaseLocation` whose area contains the position, or None. This is a lookup in a precomputed grid")
+        .def("get_base_location", py::overload_cast<const CCTilePosition &>(&BaseLocationManager::getBaseLocationAt, py::const_), py::return_value_policy::reference, "point2di"_a)
+        .def("get_expansion_order", &BaseLocationManager::getExpansionOrder, py::return_value_policy::reference, "player_constant"_a, "Returns the :class:`library.BaseLocation` that no player occupies and that can be reached from the start location of the provided :ref:`playerconstants`, closest first. A base counts as occupied as soon as any building stands in it, unlike get_next_expansion which only checks that a town hall still fits")
+        .def("get_ground_distance", &BaseLocationManager::getGroundDistance, "from"_a, "to"_a, "Returns the ground distance from the resources of one :class:`library.BaseLocation` to the depot position of the other at the start of the game, or -1 if they aren't connected")
+        .def_property_readonly("base_distance_matrix", [](py::object self)
+        {
+            // a read-only view of the matrix, which lives as long as the manager
+            const BaseLocationManager & manager = self.cast<const BaseLocationManager &>();
+            const std::vector<int> & distances = manager.getBaseDistanceMatrix();
+            py::ssize_t numBases = (py::ssize_t)manager.getBaseLocations().size();
+
+            return readOnlyView(distances.data(), { numBases, numBases }, self);
+        }, "A read-only int32 numpy array where base_distance_matrix[a, b] is get_ground_distance from the base location with base_id a to the one with base_id b");
 }
\ No newline at end of file
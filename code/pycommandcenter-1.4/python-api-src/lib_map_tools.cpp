@@ -2,16 +2,85 @@
 
 namespace py = pybind11;
 
+namespace
+{
+    // a read-only array of shape (height, width) over the grid's own buffer, owner is kept alive as long as the array is
+    template <class T>
+    py::array_t<T> gridView(const TileGrid<T> & grid, py::handle owner)
+    {
+        return readOnlyView(grid.data(), { (py::ssize_t)grid.height(), (py::ssize_t)grid.width() }, owner);
+    }
+
+    // bool grids are stored as packed bits, which numpy can't view directly, so they are unpacked into a new array in one pass
+    py::array_t<bool> gridCopy(const TileGrid<bool> & grid)
+    {
+        py::array_t<bool> copy({ (py::ssize_t)grid.height(), (py::ssize_t)grid.width() });
+        bool * out = copy.mutable_data();
+        const uint64_t * words = grid.words();
+        for (size_t i=0; i<grid.size(); ++i)
+        {
+            out[i] = (words[i >> 6] >> (i & 63)) & 1;
+        }
+        return copy;
+    }
+}
+
 void define_map_tools(py::module & m)
 {
-    py::class_<DistanceMap>(m, "DistanceMap")
-        .def("computer_distance_map", &DistanceMap::computeDistanceMap, "bot"_a, "start_tile"_a)
+    py::enum_<DistanceMetric>(m, "DistanceMetric")
+        .value("FourConnected", DistanceMetric::FourConnected, "Moves only horizontally and vertically, every step costs one tile")
+        .value("Octile", DistanceMetric::Octile, "Also moves diagonally at a cost of about 1.4 tiles, without cutting around blocked corners");
+
+    // DistanceMaps are shared with the MapTools cache and the base locations, so Python gets a handle to the same instance instead of a copy.
+    // Nothing bound here changes a map once it has been computed, which is what makes handing out the shared instances safe
+    py::class_<DistanceMap, std::shared_ptr<DistanceMap>>(m, "DistanceMap")
+        .def(py::init([](IDABot & bot, const CCTilePosition & start_tile, DistanceMetric metric)
+            {
+                auto map = std::make_shared<DistanceMap>();
+                map->computeDistanceMap(bot, start_tile, metric);
+                return map;
+            }), "Computes a new map of the distances from start_tile, which is not shared with the MapTools cache", "bot"_a, "start_tile"_a, "metric"_a = DistanceMetric::FourConnected)
         .def("get_distance", py::overload_cast<const CCTilePosition &>(&DistanceMap::getDistance, py::const_), "position"_a)
         .def("get_distance", py::overload_cast<const CCPosition &>(&DistanceMap::getDistance, py::const_), "position"_a)
         .def("get_sorted_tiles", &DistanceMap::getSortedTiles)
+        .def("get_num_sorted_tiles", &DistanceMap::getNumSortedTiles, "Number of tiles reachable from the start tile")
+        .def("get_sorted_tile", &DistanceMap::getSortedTile, "Returns the i:th closest tile, without building the full list of sorted tiles", "i"_a)
         .def("get_start_tile", &DistanceMap::getStartTile)
+        .def("get_metric", &DistanceMap::getMetric, "The :class:`library.DistanceMetric` the map was computed with")
+        .def_property_readonly("distances", [](py::object self) { return gridView(self.cast<const DistanceMap &>().getDistanceGrid(), self); }, "A read-only uint16 numpy array of shape (height, width) sharing memory with the map, indexed as distances[y, x]. Unreachable tiles are 65535, octile maps store fifths of a tile")
         .def("draw", &DistanceMap::draw, "bot"_a);
 
+    py::class_<DistanceMapCacheStats>(m, "DistanceMapCacheStats")
+        .def_readonly("hits", &DistanceMapCacheStats::hits, "Number of distance map lookups answered from the cache")
+        .def_readonly("misses", &DistanceMapCacheStats::misses, "Number of distance map lookups that had to compute a new map")
+        .def_readonly("evictions", &DistanceMapCacheStats::evictions, "Number of distance maps dropped to stay within the memory budget")
+        .def_readonly("invalidations", &DistanceMapCacheStats::invalidations, "Number of distance maps dropped because a building was placed or removed on tiles they cover")
+        .def_readonly("entries", &DistanceMapCacheStats::entries, "Number of distance maps currently in the cache")
+        .def_readonly("pinned", &DistanceMapCacheStats::pinned, "Number of cached distance maps that are never evicted (the ones used by base locations)")
+        .def_readonly("bytes", &DistanceMapCacheStats::bytes, "Approximate memory used by the cached distance maps, in bytes")
+        .def_readonly("budget", &DistanceMapCacheStats::budget, "Memory budget of the cache, in bytes");
+
+    // regions and chokepoints belong to MapTools and live for the whole game, so Python only gets references to them
+    py::class_<Chokepoint>(m, "Chokepoint")
+        .def_property_readonly("id", &Chokepoint::getId, "Index of the chokepoint in MapTools.chokepoints")
+        .def_property_readonly("region_a", &Chokepoint::getRegionA, py::return_value_policy::reference, "One of the two :class:`library.Region` the chokepoint connects")
+        .def_property_readonly("region_b", &Chokepoint::getRegionB, py::return_value_policy::reference, "The other :class:`library.Region` the chokepoint connects")
+        .def("get_other_region", &Chokepoint::getOtherRegion, py::return_value_policy::reference, "region"_a, "Returns the region on the other side of the chokepoint, or None if the given region isn't connected by it")
+        .def_property_readonly("center", &Chokepoint::getCenter, "The most open tile of the chokepoint, as a :class:`library.Point2DI`")
+        .def_property_readonly("side_a", &Chokepoint::getSideA, "The tile at one end of the line across the chokepoint")
+        .def_property_readonly("side_b", &Chokepoint::getSideB, "The tile at the other end of the line across the chokepoint")
+        .def_property_readonly("width", &Chokepoint::getWidth, "The width of the chokepoint in tiles")
+        .def_property_readonly("tiles", &Chokepoint::getTiles, "The tiles making up the line across the chokepoint");
+
+    py::class_<Region>(m, "Region")
+        .def_property_readonly("id", &Region::getId, "Index of the region in MapTools.regions")
+        .def_property_readonly("num_tiles", &Region::getNumTiles, "Number of walkable tiles in the region")
+        .def_property_readonly("altitude", &Region::getAltitude, "Distance in tiles from the center of the region to the closest unwalkable tile")
+        .def_property_readonly("center", &Region::getCenter, "The tile of the region furthest away from any unwalkable tile")
+        .def_property_readonly("chokepoints", &Region::getChokepoints, py::return_value_policy::reference, "The :class:`library.Chokepoint` leading out of the region")
+        .def_property_readonly("neighbours", &Region::getNeighbours, py::return_value_policy::reference, "The regions that share a chokepoint with this region")
+        .def("is_neighbour", &Region::isNeighbour, "region"_a);
+
     const CCColor white{ 255, 255, 255 };
     py::class_<MapTools>(m, "MapTools")
         .def_property_readonly("width", &MapTools::width, "The width of the map")
@@ -35,16 +104,37 @@ void define_map_tools(py::module & m)
         .def("is_connected", py::overload_cast<int, int, int, int>(&MapTools::isConnected, py::const_), "x1"_a, "y1"_a, "x2"_a, "y2"_a, "Returns if the coordinates are connected")
         .def("is_connected", py::overload_cast<const CCTilePosition &, const CCTilePosition &>(&MapTools::isConnected, py::const_), "from"_a, "too"_a, "Returns if the tiles are connected")
         .def("is_connected", py::overload_cast<const CCPosition &, const CCPosition &>(&MapTools::isConnected, py::const_), "from"_a, "too"_a, "Returns if the positions are of two connected tiles")
-        .def("is_walkable", py::overload_cast<int, int>(&MapTools::isWalkable, py::const_), "x"_a, "y"_a, "Returns if the coordinates is walkable")
-        .def("is_walkable", py::overload_cast<const CCTilePosition &>(&MapTools::isWalkable, py::const_), "point2di"_a, "Returns if the tile is walkable")
+        .def("is_walkable", py::overload_cast<int, int>(&MapTools::isTerrainWalkable, py::const_), "x"_a, "y"_a, "Returns if the coordinates is walkable. This is the terrain only, use is_blocked to also check for buildings")
+        .def("is_walkable", py::overload_cast<const CCTilePosition &>(&MapTools::isTerrainWalkable, py::const_), "point2di"_a, "Returns if the tile is walkable. This is the terrain only, use is_blocked to also check for buildings")
+        .def("is_blocked", &MapTools::isBlocked, "x"_a, "y"_a, "Returns if a building, of any player, stands on the coordinates")
         .def("is_buildable", py::overload_cast<int, int>(&MapTools::isBuildable, py::const_), "x"_a, "y"_a, "Return if it is possible to build at the provided coordinate")
         .def("is_buildable", py::overload_cast<const CCTilePosition &>(&MapTools::isBuildable, py::const_), "point2di"_a, "Return if it is possible to build on tile")
         .def("is_visible", &MapTools::isVisible, "x"_a, "y"_a, "Can you see the coordinates")
         .def("can_build_type_at_position", &MapTools::canBuildTypeAtPosition, "x"_a, "y"_a, "unit_type"_a, "Is it possible to build the provided unittype at the location")
         .def("is_depot_buildable_tile", &MapTools::isDepotBuildableTile, "x"_a, "y"_a, "Is it possbile do build a depot at the position")
-        .def("get_ground_distance", &MapTools::getGroundDistance, "Returns the ground distance between the two points. Note that this uses a BFS approach and may overshoot a bit. The function will also do the calculations with integers resulting in that sometimes when close to a wall it might return -1 even though a path is available", "from"_a, "to"_a)
-        .def("get_distance_map", py::overload_cast<const CCTilePosition &>(&MapTools::getDistanceMap, py::const_), "point2di"_a)
-        .def("get_distance_map", py::overload_cast<const CCPosition &>(&MapTools::getDistanceMap, py::const_), "point2d"_a)
+        .def("get_ground_distance", &MapTools::getGroundDistance, "Returns the ground distance between the two points. With the default metric this only moves horizontally and vertically between tiles and may overshoot a bit, pass DistanceMetric.Octile to also move diagonally. The function will also do the calculations with integers resulting in that sometimes when close to a wall it might return -1 even though a path is available. A cached distance map for 'to' is used if one exists, otherwise only the tiles between the two points are searched", "from"_a, "to"_a, "metric"_a = DistanceMetric::FourConnected)
+        .def("get_ground_path", &MapTools::getGroundPath, "Returns a list of :class:`library.Point2DI` tiles making up a shortest ground path from the first point to the second, with the same distance as get_ground_distance. The list is empty if there is no path", "from"_a, "to"_a, "metric"_a = DistanceMetric::FourConnected)
+        .def("get_approx_ground_distance", &MapTools::getApproxGroundDistance, "Returns an approximate ground distance between the two points, found by searching a precomputed graph of map clusters instead of the tiles. It is much faster than get_ground_distance and meant for many queries per frame, but may overshoot the true distance by a few tiles. Returns -1 if there is no path", "from"_a, "to"_a)
+        .def("get_approx_ground_path", &MapTools::getApproxGroundPath, "Returns a list of :class:`library.Point2DI` tiles making up the ground path found by get_approx_ground_distance. The list is empty if there is no path", "from"_a, "to"_a)
+        .def("get_distance_map", [](const MapTools & map, const CCTilePosition & tile, DistanceMetric metric) { return std::const_pointer_cast<DistanceMap>(map.getDistanceMap(tile, metric)); }, "point2di"_a, "metric"_a = DistanceMetric::FourConnected)
+        .def("get_distance_map", [](const MapTools & map, const CCPosition & pos, DistanceMetric metric) { return std::const_pointer_cast<DistanceMap>(map.getDistanceMap(pos, metric)); }, "point2d"_a, "metric"_a = DistanceMetric::FourConnected)
+        .def_property_readonly("distance_map_cache_stats", &MapTools::getDistanceMapCacheStats, "Hit, miss and eviction counters of the distance map cache, as a :class:`library.DistanceMapCacheStats`")
+        .def_property("map_cache_directory", &MapTools::getMapCacheDirectory, &MapTools::setMapCacheDirectory, "Directory where the terrain analysis, base locations and base distance maps are saved at the start of a game, so that later games on the same map can load them instead of computing them again. The directory has to exist. Empty, the default, turns the cache off. Set it before the game starts")
+        .def_property_readonly("loaded_from_map_cache", &MapTools::isLoadedFromMapCache, "Whether the analysis of this map was loaded from map_cache_directory")
+        .def("set_distance_map_cache_budget", &MapTools::setDistanceMapCacheBudget, "Sets how much memory, in bytes, the cached distance maps may use before the least recently used ones are evicted", "bytes"_a)
         .def("get_closest_tiles_to", &MapTools::getClosestTilesTo, "Returns a list of positions, where the first position is the closest and the last is the furthest", "point2di"_a)
-        .def("get_least_recently_seen_tile", &MapTools::getLeastRecentlySeenTile, "Returns the tile that the most time has passed since it was visible");
+        .def("get_least_recently_seen_tile", &MapTools::getLeastRecentlySeenTile, "Returns the tile that the most time has passed since it was visible")
+        .def_property_readonly("regions", &MapTools::getRegions, "A list of all :class:`library.Region` on the map, computed at the start of the game")
+        .def_property_readonly("chokepoints", &MapTools::getChokepoints, "A list of all :class:`library.Chokepoint` on the map, computed at the start of the game")
+        .def("get_region", py::overload_cast<int, int>(&MapTools::getRegion, py::const_), py::return_value_policy::reference, "x"_a, "y"_a, "Returns the :class:`library.Region` of the tile, or None if the tile isn't walkable")
+        .def("get_region", py::overload_cast<const CCTilePosition &>(&MapTools::getRegion, py::const_), py::return_value_policy::reference, "point2di"_a)
+        .def("get_region", py::overload_cast<const CCPosition &>(&MapTools::getRegion, py::const_), py::return_value_policy::reference, "point2d"_a)
+        .def("get_altitude", &MapTools::getAltitude, "x"_a, "y"_a, "Returns the distance in tiles from the tile to the closest unwalkable tile, 0 if the tile isn't walkable")
+        .def_property_readonly("walkable_grid", [](const MapTools & map) { return gridCopy(map.getTerrainWalkableGrid()); }, "A bool numpy array of shape (height, width) with is_walkable for every tile, indexed as walkable_grid[y, x]. The tiles are stored as bits in C++, so this is a new array each time")
+        .def_property_readonly("buildable_grid", [](const MapTools & map) { return gridCopy(map.getBuildableGrid()); }, "Like walkable_grid, with is_buildable for every tile")
+        .def_property_readonly("depot_buildable_grid", [](const MapTools & map) { return gridCopy(map.getDepotBuildableGrid()); }, "Like walkable_grid, with is_depot_buildable_tile for every tile")
+        .def_property_readonly("sector_grid", [](py::object self) { return gridView(self.cast<const MapTools &>().getSectorGrid(), self); }, "A read-only int32 numpy array of shape (height, width) with the connectivity sector of every tile, 0 for unwalkable tiles. Two tiles are ground connected if they have the same sector. The array shares memory with MapTools and follows it as buildings are placed and removed. The grids are allocated again when a game starts, so the array is only valid for the game it was taken in and has to be fetched again in the next one")
+        .def_property_readonly("terrain_height_grid", [](py::object self) { return gridView(self.cast<const MapTools &>().getTerrainHeightGrid(), self); }, "A read-only float32 numpy array of shape (height, width) with the terrain height at the center of every tile, sharing memory with MapTools. The grids are allocated again when a game starts, so the array is only valid for the game it was taken in and has to be fetched again in the next one")
+        .def_property_readonly("last_seen_grid", [](py::object self) { return gridView(self.cast<const MapTools &>().getLastSeenGrid(), self); }, "A read-only int32 numpy array of shape (height, width) with the frame every tile was last visible, sharing memory with MapTools so it updates every frame. The grids are allocated again when a game starts, so the array is only valid for the game it was taken in and has to be fetched again in the next one")
+        .def_property_readonly("visibility_grid", [](py::object self) { return gridView(self.cast<const MapTools &>().getVisibilityGrid(), self); }, "A read-only uint8 numpy array of shape (height, width) with the visibility of every tile, hidden (0), fogged (1) or visible (2). It shares memory with MapTools so it updates every frame. The grids are allocated again when a game starts, so the array is only valid for the game it was taken in and has to be fetched again in the next one");
 }
\ No newline at end of file
@@ -0,0 +1,52 @@
+#include "library.h"
+
+namespace py = pybind11;
+
+namespace
+{
+    // a read-only one dimensional array over the column's own buffer, which keeps the snapshot alive
+    template <class T>
+    void defColumn(py::class_<UnitSnapshot, std::shared_ptr<UnitSnapshot>> & snapshot, const char * name, std::vector<T> UnitSnapshot::* column, const char * doc)
+    {
+        snapshot.def_property_readonly(name, [column](py::object self)
+            {
+                const std::vector<T> & values = self.cast<const UnitSnapshot &>().*column;
+                return readOnlyView(values.data(), { (py::ssize_t)values.size() }, self);
+            }, doc);
+    }
+}
+
+void define_unit_snapshot(py::module & m)
+{
+    py::class_<UnitSnapshot, std::shared_ptr<UnitSnapshot>> snapshot(m, "UnitSnapshot", "The units of one frame as read-only numpy arrays, entry i of every array belongs to unit i of :meth:`library.IDABot.get_all_units` on that frame. The arrays share memory with the snapshot and stay valid after the frame has passed");
+
+    snapshot
+        .def("__len__", &UnitSnapshot::size)
+        .def_readonly("frame", &UnitSnapshot::frame, "The frame the snapshot was taken on");
+
+    defColumn(snapshot, "tags", &UnitSnapshot::tags, "uint64 array with the :any:`Unit.id` of every unit");
+    defColumn(snapshot, "unit_types", &UnitSnapshot::unitTypes, "uint32 array with the :class:`library.UNIT_TYPEID` of every unit as a number");
+    defColumn(snapshot, "players", &UnitSnapshot::players, "int32 array with the :any:`Unit.player` of every unit, compare it with PLAYER_SELF and the other player constants");
+    defColumn(snapshot, "x", &UnitSnapshot::x, "float32 array with the x coordinate of every unit");
+    defColumn(snapshot, "y", &UnitSnapshot::y, "float32 array with the y coordinate of every unit");
+    defColumn(snapshot, "radius", &UnitSnapshot::radius, "float32 array with the radius of every unit");
+    defColumn(snapshot, "hit_points", &UnitSnapshot::health, "float32 array with the hit points of every unit");
+    defColumn(snapshot, "max_hit_points", &UnitSnapshot::maxHealth, "float32 array with the maximum hit points of every unit");
+    defColumn(snapshot, "shields", &UnitSnapshot::shields, "float32 array with the shields of every unit");
+    defColumn(snapshot, "max_shields", &UnitSnapshot::maxShields, "float32 array with the maximum shields of every unit");
+    defColumn(snapshot, "energy", &UnitSnapshot::energy, "float32 array with the energy of every unit");
+    defColumn(snapshot, "max_energy", &UnitSnapshot::maxEnergy, "float32 array with the maximum energy of every unit");
+    defColumn(snapshot, "build_progress", &UnitSnapshot::buildProgress, "float32 array with the build progress of every unit, 1.0 when it is completed");
+    defColumn(snapshot, "flags", &UnitSnapshot::flags, "uint32 array with the flags of every unit, test them with the FLAG_ constants of this class, for example (snapshot.flags & UnitSnapshot.FLAG_FLYING) != 0");
+
+    snapshot.attr("FLAG_FLYING") = (uint32_t)UnitSnapshot::Flying;
+    snapshot.attr("FLAG_BURROWED") = (uint32_t)UnitSnapshot::Burrowed;
+    snapshot.attr("FLAG_CLOAKED") = (uint32_t)UnitSnapshot::Cloaked;
+    snapshot.attr("FLAG_POWERED") = (uint32_t)UnitSnapshot::Powered;
+    snapshot.attr("FLAG_IDLE") = (uint32_t)UnitSnapshot::Idle;
+    snapshot.attr("FLAG_COMPLETED") = (uint32_t)UnitSnapshot::Completed;
+    snapshot.attr("FLAG_BLIP") = (uint32_t)UnitSnapshot::Blip;
+    snapshot.attr("FLAG_CARRYING_MINERALS") = (uint32_t)UnitSnapshot::CarryingMinerals;
+    snapshot.attr("FLAG_CARRYING_GAS") = (uint32_t)UnitSnapshot::CarryingGas;
+    snapshot.attr("FLAG_ALIVE") = (uint32_t)UnitSnapshot::Alive;
+}
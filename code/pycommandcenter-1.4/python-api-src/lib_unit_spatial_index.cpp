@@ -0,0 +1,56 @@
+#include "library.h"
+
+namespace py = pybind11;
+
+void define_unit_spatial_index(py::module & m)
+{
+    py::enum_<UnitLayer>(m, "UnitLayer")
+        .value("Any", UnitLayer::Any, "Both flying and ground units")
+        .value("Ground", UnitLayer::Ground, "Units that aren't flying, buildings included")
+        .value("Air", UnitLayer::Air, "Flying units");
+
+    // the filter is spread out over keyword arguments, which reads better from Python than a filter object
+    py::class_<UnitSpatialIndex>(m, "UnitSpatialIndex")
+        .def("__len__", &UnitSpatialIndex::size)
+        .def("__getitem__", [](const UnitSpatialIndex & index, size_t i)
+            {
+                if (i >= index.size())
+                {
+                    throw py::index_error();
+                }
+                return index.getUnit(i);
+            }, "The unit with the given index, as returned by get_nearest_units_batch. The units are numbered as in the list the index was built from, for IDABot.unit_spatial_index that is get_all_units() of the same frame")
+        .def("get_units_in_radius", [](const UnitSpatialIndex & index, const CCPosition & center, float radius, int player, UnitLayer layer, const UnitType & type)
+            {
+                return index.getUnitsInRadius(center, radius, UnitFilter(player, layer, type));
+            }, "Returns the units at most radius away from center, in no particular order. Only units of the given player (-1 for all players), :class:`library.UnitLayer` and :class:`library.UnitType` (an invalid type for all types) are returned",
+            "center"_a, "radius"_a, "player"_a = UnitFilter::AnyPlayer, "layer"_a = UnitLayer::Any, "unit_type"_a = UnitType())
+        .def("get_units_in_rectangle", [](const UnitSpatialIndex & index, const CCPosition & bottom_left, const CCPosition & top_right, int player, UnitLayer layer, const UnitType & type)
+            {
+                return index.getUnitsInRectangle(bottom_left, top_right, UnitFilter(player, layer, type));
+            }, "Returns the units inside the rectangle from bottom_left to top_right, edges included, in no particular order. The filters work like in get_units_in_radius",
+            "bottom_left"_a, "top_right"_a, "player"_a = UnitFilter::AnyPlayer, "layer"_a = UnitLayer::Any, "unit_type"_a = UnitType())
+        .def("get_nearest_units", [](const UnitSpatialIndex & index, const CCPosition & center, size_t k, int player, UnitLayer layer, const UnitType & type, float max_distance)
+            {
+                return index.getNearestUnits(center, k, UnitFilter(player, layer, type), max_distance);
+            }, "Returns the k units closest to center, closest first, leaving out units further away than max_distance. The filters work like in get_units_in_radius",
+            "center"_a, "k"_a, "player"_a = UnitFilter::AnyPlayer, "layer"_a = UnitLayer::Any, "unit_type"_a = UnitType(), "max_distance"_a = std::numeric_limits<float>::max())
+        .def("get_nearest_units_batch", [](const UnitSpatialIndex & index, const std::vector<Unit> & units, size_t k, int player, UnitLayer layer, float max_distance)
+            {
+                // the arrays share the memory of the result, which is freed once the last of them is gone
+                NearestUnits * result = new NearestUnits();
+                py::capsule owner(result, [](void * p) { delete static_cast<NearestUnits *>(p); });
+                {
+                    py::gil_scoped_release release;
+                    index.findNearestForUnits(units, k, UnitFilter(player, layer), max_distance, *result);
+                }
+
+                // numpy bools are single bytes, so the in range flags can be viewed as they are
+                static_assert(sizeof(bool) == sizeof(uint8_t), "bool has to be one byte to view the in range flags");
+                std::vector<py::ssize_t> shape = { (py::ssize_t)result->rows, (py::ssize_t)result->k };
+                return py::make_tuple(readOnlyView(result->indices.data(), shape, owner),
+                                      readOnlyView(result->distances.data(), shape, owner),
+                                      readOnlyView(reinterpret_cast<const bool *>(result->inRange.data()), shape, owner));
+            }, "For every one of the units, finds the k closest units of the given player (the enemy by default) and :class:`library.UnitLayer`. Returns three numpy arrays of shape (len(units), k), closest first: the indices of the found units, which are their positions in get_all_units() and the :class:`library.UnitSnapshot` columns of the same frame and can also be looked up with index[i], their distances, and whether the unit of the row can reach them with the longest of its weapons that can hit air or ground units, whichever they are. Rows with fewer than k units are padded with an index of -1 and an infinite distance. Large groups are searched on several threads",
+            "units"_a, "k"_a, "player"_a = (int)Players::Enemy, "layer"_a = UnitLayer::Any, "max_distance"_a = std::numeric_limits<float>::max());
+}
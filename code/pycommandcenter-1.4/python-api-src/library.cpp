@@ -17,6 +17,8 @@ PYBIND11_MODULE(library, m)
     define_color(m);
     define_map_tools(m);
     define_building_placer(m);
+    define_unit_snapshot(m);
+    define_unit_spatial_index(m);
 
     // Note: This is not sc2::Coordinator but a small wrapper class which
     // overrides the constructor of sc2::Coordinator, see library.h.
@@ -83,6 +85,7 @@ PYBIND11_MODULE(library, m)
 		.def("send_chat", &IDABot::SendChat, "Sends the string 'message' to the game chat", "message"_a)
 		.def("get_all_units", &IDABot::GetAllUnits, "Returns a list of all visible units, including minerals and geysers")
 		.def("get_my_units", &IDABot::GetMyUnits, "Returns a list of all your units") 
+		.def("get_unit_snapshot", [](const IDABot & bot) { return std::const_pointer_cast<UnitSnapshot>(bot.GetUnitSnapshot()); }, "Returns a :class:`library.UnitSnapshot` with the values of all units of :meth:`get_all_units` as numpy arrays, built at most once per frame")
 		.def("get_player_race", &IDABot::GetPlayerRace, "Returns the players race, useful if you play Race.Random")
 		.def("debug_create_unit", &IDABot::DebugCreateUnit, "This method creates the nr (INT) of units on the position :class:`library.Point2D`, the unit belongs to the Player Constant", "unit_type"_a, "p"_a, "player_id"_a = 0, "count"_a = 1)
 		.def("debug_kill_unit", &IDABot::DebugKillUnit, "Kill the unit from debug mode")
@@ -114,6 +117,7 @@ PYBIND11_MODULE(library, m)
 		.def_property_readonly("tech_tree", &IDABot::GetTechTree, "An instance of the class :class:`library.TechTree`")
 		.def_property_readonly("map_tools", &IDABot::Map, "An instance of the class :class:`library.MapTools`")
 		.def_property_readonly("building_placer", &IDABot::GetBuildingPlacer, "An instance of the class :class:`library.BuildingPlacer`")
+		.def_property_readonly("unit_spatial_index", &IDABot::GetUnitSpatialIndex, "A :class:`library.UnitSpatialIndex` over the units of :meth:`get_all_units`, rebuilt at the start of every step, so a handle kept from an earlier frame answers for the current units")
 		.def_property_readonly("start_location", &IDABot::GetStartLocation, "CCPosition representing the start location, note that it is the depot position that is returned.")
 		.def_property_readonly("start_locations", &IDABot::GetStartLocations, "List of CCPositions representing the start locations, note that it is the depot positions and not the center positions")
 		.def_property_readonly("minerals", &IDABot::GetMinerals, "How much minerals we currently have")
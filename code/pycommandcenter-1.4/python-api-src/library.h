@@ -1,6 +1,7 @@
 #pragma once
 
 #include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
 #include <sc2api/sc2_api.h>
 #include "../src/IDABot.h"
 #include "../src/IDAReplayObserver.h"
@@ -11,6 +12,22 @@
 // Lets us use "x"_a instead of py::arg("x"), great.
 using namespace pybind11::literals;
 
+// A read-only, row-major numpy array of the given shape over memory owned by C++, without copying it.
+// The array keeps owner alive, so data has to live at least as long as owner does.
+template <class T>
+pybind11::array_t<T> readOnlyView(const T * data, const std::vector<pybind11::ssize_t> & shape, pybind11::handle owner)
+{
+    std::vector<pybind11::ssize_t> strides(shape.size(), (pybind11::ssize_t)sizeof(T));
+    for (size_t i = shape.size(); i > 1; --i)
+    {
+        strides[i - 2] = strides[i - 1] * shape[i - 1];
+    }
+
+    pybind11::array_t<T> view(shape, strides, data, owner);
+    view.attr("setflags")("write"_a = false);
+    return view;
+}
+
 // Wrapper class since the initialization uses pure argc/argv and these cannot be wrapped into Python correctly
 class Coordinator : public sc2::Coordinator
 {
@@ -131,3 +148,5 @@ void define_tech_tree(pybind11::module & m);
 void define_color(pybind11::module & m);
 void define_map_tools(pybind11::module & m);
 void define_building_placer(pybind11::module & m);
+void define_unit_snapshot(pybind11::module & m);
+void define_unit_spatial_index(pybind11::module & m);
@@ -14,6 +14,10 @@ BaseLocation::BaseLocation(IDABot & bot, int baseID, const std::vector<Unit> & r
     , m_right                (std::numeric_limits<CCPositionType>::lowest())
     , m_top                  (std::numeric_limits<CCPositionType>::lowest())
     , m_bottom               (std::numeric_limits<CCPositionType>::max())
+    , m_region               (nullptr)
+    , m_remainingMinerals    (0)
+    , m_remainingGas         (0)
+    , m_distanceMapVersion   (0)
 {
     m_isPlayerStartLocation[0] = false;
     m_isPlayerStartLocation[1] = false;
@@ -58,11 +62,14 @@ BaseLocation::BaseLocation(IDABot & bot, int baseID, const std::vector<Unit> & r
     // calculate the center of the resources
     size_t numResources = m_minerals.size() + m_geysers.size();
 
-    m_centerOfResources = CCPosition(m_left + (m_right-m_left)/2, m_top + (m_bottom-m_top)/2);
+    m_centerOfResources = CalcCenterOfResources(resources);
 
     // compute this BaseLocation's DistanceMap, which will compute the ground distance
     // from the center of its recourses to every other tile on the map
-    m_distanceMap = m_bot.Map().getDistanceMap(m_centerOfResources);
+    // the map is pinned so it is never evicted from the MapTools cache
+    m_distanceMap = m_bot.Map().pinDistanceMap(m_centerOfResources);
+    m_distanceMapVersion = m_bot.Map().getWalkableVersion();
+    std::shared_ptr<const DistanceMap> distanceMap = m_distanceMap;
 
     // check to see if this is a start location for the map
     for (auto & pos : m_bot.GetStartLocations())
@@ -86,8 +93,8 @@ BaseLocation::BaseLocation(IDABot & bot, int baseID, const std::vector<Unit> & r
         }
     }
     
-    // if it's not a start location, we need to calculate the depot position
-    if (!isStartLocation())
+    // if it's not a start location, we need to calculate the depot position, unless an earlier game on this map already did
+    if (!isStartLocation() && !m_bot.Map().getCachedDepotPosition(Util::GetTilePosition(m_centerOfResources), m_depotPosition))
     {
         UnitType depot = Util::GetTownHall(m_bot.GetPlayerRace(Players::Self), m_bot);
 #ifdef SC2API
@@ -99,8 +106,10 @@ BaseLocation::BaseLocation(IDABot & bot, int baseID, const std::vector<Unit> & r
 #endif
         
         // the position of the depot will be the closest spot we can build one from the resource center
-        for (auto & tile : getClosestTiles())
+        for (size_t i(0); i < distanceMap->getNumSortedTiles(); ++i)
         {
+            CCTilePosition tile = distanceMap->getSortedTile(i);
+
             // the build position will be up-left of where this tile is
             // this means we are positioning the center of the resouce depot
             CCTilePosition buildTile(tile.x - offsetX, tile.y - offsetY);
@@ -112,6 +121,39 @@ BaseLocation::BaseLocation(IDABot & bot, int baseID, const std::vector<Unit> & r
             }
         }
     }
+
+    m_region = m_bot.Map().getRegion(m_depotPosition);
+    if (m_region == nullptr)
+    {
+        m_region = m_bot.Map().getRegion(Util::GetTilePosition(m_centerOfResources));
+    }
+}
+
+CCPosition BaseLocation::CalcCenterOfResources(const std::vector<Unit> & resources)
+{
+    CCPositionType left   = std::numeric_limits<CCPositionType>::max();
+    CCPositionType right  = std::numeric_limits<CCPositionType>::lowest();
+    CCPositionType top    = std::numeric_limits<CCPositionType>::lowest();
+    CCPositionType bottom = std::numeric_limits<CCPositionType>::max();
+
+    // the same box as the one the constructor builds
+    for (auto & resource : resources)
+    {
+        CCPositionType resWidth = Util::TileToPosition(1);
+        CCPositionType resHeight = Util::TileToPosition(0.5);
+
+        left   = std::min(left,   resource.getPosition().x - resWidth);
+        right  = std::max(right,  resource.getPosition().x + resWidth);
+        top    = std::max(top,    resource.getPosition().y + resHeight);
+        bottom = std::min(bottom, resource.getPosition().y - resHeight);
+    }
+
+    return CCPosition(left + (right-left)/2, top + (bottom-top)/2);
+}
+
+const Region * BaseLocation::getRegion() const
+{
+    return m_region;
 }
 
 // TODO: calculate the actual depot position
@@ -139,6 +181,41 @@ void BaseLocation::setGeysers(std::vector<Unit> & geysers) {
 	m_geysers = geysers;
 }
 
+void BaseLocation::addResource(const Unit & resource)
+{
+    std::vector<Unit> & resources = resource.getType().isMineral() ? m_minerals : m_geysers;
+    resources.push_back(resource);
+}
+
+void BaseLocation::removeResource(const Unit & resource)
+{
+    std::vector<Unit> & resources = resource.getType().isMineral() ? m_minerals : m_geysers;
+    for (size_t i(0); i < resources.size(); ++i)
+    {
+        if (resources[i].getID() == resource.getID())
+        {
+            resources.erase(resources.begin() + i);
+            return;
+        }
+    }
+}
+
+void BaseLocation::changeRemainingResources(int minerals, int gas)
+{
+    m_remainingMinerals += minerals;
+    m_remainingGas += gas;
+}
+
+int BaseLocation::getRemainingMinerals() const
+{
+    return m_remainingMinerals;
+}
+
+int BaseLocation::getRemainingGas() const
+{
+    return m_remainingGas;
+}
+
 bool BaseLocation::isInResourceBox(int tileX, int tileY) const
 {
     CCPositionType px = Util::TileToPosition((float)tileX);
@@ -168,7 +245,33 @@ bool BaseLocation::containsPosition(const CCPosition & pos) const
         return false;
     }
 
-    return getGroundDistance(pos) < NearBaseLocationTileDistance;
+    // unreachable tiles used to count as contained, and tiles under buildings are reached by stepping onto them
+    // so that the base keeps containing its own buildings, like the tile-to-base grid does
+    int dist = getGroundDistance(pos);
+    return dist >= 0 && dist < NearBaseLocationTileDistance;
+}
+
+std::vector<CCTilePosition> BaseLocation::getContainedTiles() const
+{
+    // the sorted tiles of the distance map are exactly the ones close enough, as long as we stop in time
+    std::shared_ptr<const DistanceMap> distanceMap = getDistanceMap();
+    std::vector<CCTilePosition> tiles;
+
+    for (size_t i(0); i < distanceMap->getNumSortedTiles(); ++i)
+    {
+        CCTilePosition tile = distanceMap->getSortedTile(i);
+        if (distanceMap->getDistance(tile) >= NearBaseLocationTileDistance)
+        {
+            break;
+        }
+
+        if (tile.x != 0 || tile.y != 0)
+        {
+            tiles.push_back(tile);
+        }
+    }
+
+    return tiles;
 }
 
 const std::vector<Unit> & BaseLocation::getGeysers() const
@@ -186,14 +289,19 @@ const CCPosition & BaseLocation::getPosition() const
     return m_centerOfResources;
 }
 
+int BaseLocation::getBaseId() const
+{
+    return m_baseID;
+}
+
 int BaseLocation::getGroundDistance(const CCPosition & pos) const
 {
-    return m_distanceMap.getDistance(pos);
+    return getGroundDistance(Util::GetTilePosition(pos));
 }
 
 int BaseLocation::getGroundDistance(const CCTilePosition & pos) const
 {
-    return m_distanceMap.getDistance(pos);
+    return getDistanceMap()->getDistanceOnto(m_bot.Map(), pos);
 }
 
 bool BaseLocation::isStartLocation() const
@@ -201,9 +309,20 @@ bool BaseLocation::isStartLocation() const
     return m_isStartLocation;
 }
 
-const std::vector<CCTilePosition> & BaseLocation::getClosestTiles() const
+std::vector<CCTilePosition> BaseLocation::getClosestTiles() const
+{
+    return getDistanceMap()->getSortedTiles();
+}
+
+std::shared_ptr<const DistanceMap> BaseLocation::getDistanceMap() const
 {
-    return m_distanceMap.getSortedTiles();
+    if (m_distanceMapVersion != m_bot.Map().getWalkableVersion())
+    {
+        m_distanceMap = m_bot.Map().getDistanceMap(m_centerOfResources);
+        m_distanceMapVersion = m_bot.Map().getWalkableVersion();
+    }
+
+    return m_distanceMap;
 }
 
 void BaseLocation::draw()
@@ -264,7 +383,7 @@ void BaseLocation::draw()
 
     m_bot.Map().drawTile(m_depotPosition.x, m_depotPosition.y, CCColor(0, 0, 255)); 
 
-    //m_distanceMap.draw(m_bot);
+    //m_distanceMap->draw(m_bot);
 }
 
 bool BaseLocation::isMineralOnly() const
@@ -2,6 +2,7 @@
 
 #include "Common.h"
 #include "DistanceMap.h"
+#include "Region.h"
 #include "Unit.h"
 #include <map>
 #include <vector>
@@ -11,7 +12,6 @@ class IDABot;
 class BaseLocation
 {
     IDABot &                    m_bot;
-    DistanceMap                 m_distanceMap;
 
     CCTilePosition              m_depotPosition;
     CCPosition                  m_centerOfResources;
@@ -30,17 +30,31 @@ class BaseLocation
     CCPositionType              m_top;
     CCPositionType              m_bottom;
     bool                        m_isStartLocation;
+    const Region *              m_region;
+    int                         m_remainingMinerals;
+    int                         m_remainingGas;
+
+    // the pinned map of the base, fetched from MapTools again once the walkable tiles have changed
+    mutable std::shared_ptr<const DistanceMap> m_distanceMap;
+    mutable uint32_t            m_distanceMapVersion;
     
 public:
 
     BaseLocation(IDABot & bot, int baseID, const std::vector<Unit> & resources);
+
+    // the center of the box around the resources, where the distance map of the base starts
+    static CCPosition CalcCenterOfResources(const std::vector<Unit> & resources);
     
+    // index of the base in BaseLocationManager::getBaseLocations
+    int getBaseId() const;
     int getGroundDistance(const CCPosition & pos) const;
     int getGroundDistance(const CCTilePosition & pos) const;
     bool isStartLocation() const;
     bool isPlayerStartLocation(CCPlayer player) const;
     bool isMineralOnly() const;
     bool containsPosition(const CCPosition & pos) const;
+    // every tile containsPosition is true for, closest first
+    std::vector<CCTilePosition> getContainedTiles() const;
     const CCTilePosition & getDepotPosition() const;
     const CCPosition & getPosition() const;
     const std::vector<Unit> & getGeysers() const;
@@ -53,7 +67,20 @@ public:
 	void setMinerals(std::vector<Unit> & mineralFields);
 	void setGeysers(std::vector<Unit> & geysers);
 
-    const std::vector<CCTilePosition> & getClosestTiles() const;
+    // the resources change as fields are mined out or come into view under a new tag, kept up to date by BaseLocationManager
+    void addResource(const Unit & resource);
+    void removeResource(const Unit & resource);
+    void changeRemainingResources(int minerals, int gas);
+    // the minerals and gas left in the resources of the base, as far as we have seen them
+    int getRemainingMinerals() const;
+    int getRemainingGas() const;
+
+    std::vector<CCTilePosition> getClosestTiles() const;
+    // the map is pinned in the MapTools cache, and computed again there when buildings change the walkable tiles,
+    // a map that was handed out stays as it was
+    std::shared_ptr<const DistanceMap> getDistanceMap() const;
+    // the region the depot of this base stands in
+    const Region * getRegion() const;
 
     void draw();
 };
@@ -5,77 +5,31 @@
 
 BaseLocationManager::BaseLocationManager(IDABot & bot)
     : m_bot(bot)
+    , m_resourceUpdate(0)
+    , m_groundClustering(false)
 {
     
 }
 
 void BaseLocationManager::onStart()
 {
-    m_tileBaseLocations = std::vector<std::vector<BaseLocation *>>(m_bot.Map().width(), std::vector<BaseLocation *>(m_bot.Map().height(), nullptr));
+    m_tileBaseLocations.reset(m_bot.Map().width(), m_bot.Map().height(), nullptr);
     m_playerStartingBaseLocations[Players::Self]  = nullptr;
     m_playerStartingBaseLocations[Players::Enemy] = nullptr; 
     
     // a BaseLocation will be anything where there are minerals to mine
-    // so we will first look over all minerals and cluster them based on some distance
-    const CCPositionType clusterDistance = Util::TileToPosition(12);
-    
-    // stores each cluster of resources based on some ground distance
-    std::vector<std::vector<Unit>> resourceClusters;
-    for (auto & mineral : m_bot.GetAllUnits())
-    {
-        // skip minerals that don't have more than 100 starting minerals
-        // these are probably stupid map-blocking minerals to confuse us
-        if (!mineral.getType().isMineral())
-        {
-            continue;
-        }
+    std::vector<std::vector<Unit>> resourceClusters = clusterResources();
 
-        bool foundCluster = false;
-        for (auto & cluster : resourceClusters)
-        {
-            float dist = Util::Dist(mineral, Util::CalcCenter(cluster));
-            
-            // quick initial air distance check to eliminate most resources
-            if (dist < clusterDistance)
-            {
-                // now do a more expensive ground distance check
-                float groundDist = dist; //m_bot.Map().getGroundDistance(mineral.pos, Util::CalcCenter(cluster));
-                if (groundDist >= 0 && groundDist < clusterDistance)
-                {
-                    cluster.push_back(mineral);
-                    foundCluster = true;
-                    break;
-                }
-            }
-        }
-
-        if (!foundCluster)
-        {
-            resourceClusters.push_back(std::vector<Unit>());
-            resourceClusters.back().push_back(mineral);
-        }
-    }
-
-    // add geysers only to existing resource clusters
-    for (auto & geyser : m_bot.GetAllUnits())
+    // compute the distance maps of all bases at once on several threads, the constructors below then find them in the cache
+    std::vector<CCTilePosition> baseTiles;
+    for (auto & cluster : resourceClusters)
     {
-        if (!geyser.getType().isGeyser())
-        {
-            continue;
-        }
-
-        for (auto & cluster : resourceClusters)
+        if (cluster.size() > 4)
         {
-            //int groundDist = m_bot.Map().getGroundDistance(geyser.pos, Util::CalcCenter(cluster));
-            float groundDist = Util::Dist(geyser, Util::CalcCenter(cluster));
-
-            if (groundDist >= 0 && groundDist < clusterDistance)
-            {
-                cluster.push_back(geyser);
-                break;
-            }
+            baseTiles.push_back(Util::GetTilePosition(BaseLocation::CalcCenterOfResources(cluster)));
         }
     }
+    m_bot.Map().pinDistanceMaps(baseTiles);
 
     // add the base locations if there are more than 4 resouces in the cluster
     int baseID = 0;
@@ -110,39 +64,220 @@ void BaseLocationManager::onStart()
         }
     }
 
-    // construct the map of tile positions to base locations
-    for (int x=0; x < m_bot.Map().width(); ++x)
+    // remember which base every resource belongs to, so resources that appear under a new tag later can be put back in their base
+    for (auto & baseLocation : m_baseLocationData)
     {
-        for (int y=0; y < m_bot.Map().height(); ++y)
+        std::vector<Unit> resources = baseLocation.getMinerals();
+        resources.insert(resources.end(), baseLocation.getGeysers().begin(), baseLocation.getGeysers().end());
+
+        for (auto & resource : resources)
         {
-            for (auto & baseLocation : m_baseLocationData)
-            {
-                CCPosition pos(Util::TileToPosition(x + 0.5f), Util::TileToPosition(y + 0.5f));
+            m_resourceBases[std::make_pair(resource.getPosition().x, resource.getPosition().y)] = baseLocation.getBaseId();
+            trackResource(resource, baseLocation.getBaseId());
+        }
+    }
 
-                if (baseLocation.containsPosition(pos))
-                {
-                    m_tileBaseLocations[x][y] = &baseLocation;
-                    
-                    break;
-                }
+    // construct the map of tile positions to base locations, by writing the area of every base into the grid
+    // instead of testing every tile against every base, where bases overlap the first one keeps the tile
+    for (auto & baseLocation : m_baseLocationData)
+    {
+        for (const CCTilePosition & tile : baseLocation.getContainedTiles())
+        {
+            if (m_tileBaseLocations.get(tile.x, tile.y) == nullptr)
+            {
+                m_tileBaseLocations.set(tile.x, tile.y, &baseLocation);
             }
         }
     }
 
+    // the distance between every pair of bases, row by row in base id order
+    const size_t numBases = m_baseLocationData.size();
+    m_baseDistances.assign(numBases * numBases, -1);
+    for (size_t from=0; from<numBases; ++from)
+    {
+        for (size_t to=0; to<numBases; ++to)
+        {
+            m_baseDistances[from * numBases + to] = m_baseLocationData[from].getGroundDistance(m_baseLocationData[to].getDepotPosition());
+        }
+    }
+
     // construct the sets of occupied base locations
     m_occupiedBaseLocations[Players::Self] = std::set<const BaseLocation *>();
     m_occupiedBaseLocations[Players::Enemy] = std::set<const BaseLocation *>();
+
+    m_expansionState.clear();
+    updateExpansionOrder();
+
+    // the next game on this map can load the base distance maps and depot positions instead
+    m_bot.Map().saveMapCache(m_baseLocationPtrs);
+}
+
+// Groups the minerals into clusters based on some distance, then adds the geysers to them.
+// A resource joins the first cluster, in the order they were made, whose center is close enough.
+// The centers are kept in a grid with cells as large as that distance, so only the clusters in
+// the cells around a resource have to be looked at, and each center is updated from running sums.
+std::vector<std::vector<Unit>> BaseLocationManager::clusterResources() const
+{
+    const CCPositionType clusterDistance = Util::TileToPosition(12);
+
+    struct Cluster
+    {
+        std::vector<Unit>   resources;
+        CCPositionType      sumX = 0;
+        CCPositionType      sumY = 0;
+        CCPosition          center;
+        int64_t             cell = 0;
+        CCTilePosition      groundTile;     // a walkable tile next to the first resource, for the ground check
+    };
+
+    std::vector<Cluster> clusters;
+    std::unordered_map<int64_t, std::vector<size_t>> cells;
+
+    auto cellOf = [clusterDistance](const CCPosition & pos, int dx, int dy)
+    {
+        int64_t cx = (int64_t)std::floor(pos.x / clusterDistance) + dx;
+        int64_t cy = (int64_t)std::floor(pos.y / clusterDistance) + dy;
+        return (cx << 32) ^ (cy & 0xFFFFFFFF);
+    };
+
+    // resources aren't walkable, so the ground check uses the closest walkable tile around them
+    auto groundTileOf = [this](const Unit & resource)
+    {
+        CCTilePosition tile = resource.getTilePosition();
+        for (int radius=1; radius<=3; ++radius)
+        {
+            for (int dy=-radius; dy<=radius; ++dy)
+            {
+                for (int dx=-radius; dx<=radius; ++dx)
+                {
+                    if (m_bot.Map().isWalkable(tile.x + dx, tile.y + dy))
+                    {
+                        return CCTilePosition(tile.x + dx, tile.y + dy);
+                    }
+                }
+            }
+        }
+        return tile;
+    };
+
+    auto addToCluster = [&](size_t c, const Unit & resource)
+    {
+        Cluster & cluster = clusters[c];
+        cluster.resources.push_back(resource);
+        cluster.sumX += resource.getPosition().x;
+        cluster.sumY += resource.getPosition().y;
+
+        // the same sums in the same order as Util::CalcCenter, so the center comes out exactly the same
+        cluster.center = CCPosition(cluster.sumX / cluster.resources.size(), cluster.sumY / cluster.resources.size());
+
+        int64_t cell = cellOf(cluster.center, 0, 0);
+        if (cluster.resources.size() == 1 || cell != cluster.cell)
+        {
+            if (cluster.resources.size() > 1)
+            {
+                std::vector<size_t> & old = cells[cluster.cell];
+                old.erase(std::find(old.begin(), old.end(), c));
+            }
+            cells[cell].push_back(c);
+            cluster.cell = cell;
+        }
+    };
+
+    // the first cluster close enough to the resource, or -1
+    auto findCluster = [&](const Unit & resource)
+    {
+        size_t found = clusters.size();
+        CCTilePosition groundTile = m_groundClustering ? groundTileOf(resource) : CCTilePosition();
+
+        for (int dy=-1; dy<=1; ++dy)
+        {
+            for (int dx=-1; dx<=1; ++dx)
+            {
+                auto cell = cells.find(cellOf(resource.getPosition(), dx, dy));
+                if (cell == cells.end())
+                {
+                    continue;
+                }
+
+                for (size_t c : cell->second)
+                {
+                    if (c >= found || Util::Dist(resource, clusters[c].center) >= clusterDistance)
+                    {
+                        continue;
+                    }
+
+                    // resources on different sides of a cliff don't belong to the same base
+                    if (m_groundClustering && !m_bot.Map().isConnected(groundTile, clusters[c].groundTile))
+                    {
+                        continue;
+                    }
+
+                    found = c;
+                }
+            }
+        }
+
+        return found < clusters.size() ? (int)found : -1;
+    };
+
+    for (auto & mineral : m_bot.GetAllUnits())
+    {
+        if (!mineral.getType().isMineral())
+        {
+            continue;
+        }
+
+        int c = findCluster(mineral);
+        if (c < 0)
+        {
+            c = (int)clusters.size();
+            clusters.emplace_back();
+            clusters.back().groundTile = groundTileOf(mineral);
+        }
+
+        addToCluster(c, mineral);
+    }
+
+    // add geysers only to existing resource clusters
+    for (auto & geyser : m_bot.GetAllUnits())
+    {
+        if (!geyser.getType().isGeyser())
+        {
+            continue;
+        }
+
+        int c = findCluster(geyser);
+        if (c >= 0)
+        {
+            addToCluster(c, geyser);
+        }
+    }
+
+    std::vector<std::vector<Unit>> resourceClusters;
+    for (auto & cluster : clusters)
+    {
+        resourceClusters.push_back(std::move(cluster.resources));
+    }
+
+    return resourceClusters;
+}
+
+void BaseLocationManager::setGroundClustering(bool groundClustering)
+{
+    m_groundClustering = groundClustering;
+}
+
+bool BaseLocationManager::getGroundClustering() const
+{
+    return m_groundClustering;
 }
 
 void BaseLocationManager::onFrame()
 {   
     drawBaseLocations();
 
-	// make sure that mineralfields and geysers are up to date in the different bases
-	for (BaseLocation & baselocation : m_baseLocationData) {
-		updateMinerals(baselocation);
-		updateGeysers(baselocation);
-	}
+    // make sure that mineralfields and geysers are up to date in the different bases
+    updateResources();
 
     // reset the player occupation information for each location
     for (auto & baseLocation : m_baseLocationData)
@@ -249,34 +384,137 @@ void BaseLocationManager::onFrame()
         }
     }
 
-    // draw the debug information for each base location
-    
+    updateExpansionOrder();
 }
 
-void BaseLocationManager::updateMinerals(BaseLocation & baseToUpdate) {
-	std::vector<Unit> newMinerals;
-	for (Unit oldMineral : baseToUpdate.getMinerals()) {
-		for (auto & mineral : m_bot.GetAllUnits()) {
-			if (oldMineral.getPosition() == mineral.getPosition() && mineral.getType().isMineral()) {
-				newMinerals.push_back(mineral);
-				break;
-			}
-		}
-	}
-	baseToUpdate.setMinerals(newMinerals);
+// sorts the bases by distance from the start location of each player, but only when a start location
+// was found since the last time, whether a base can still be taken is checked when the order is used
+void BaseLocationManager::updateExpansionOrder()
+{
+    std::vector<const BaseLocation *> state;
+    for (int player : { (int)Players::Self, (int)Players::Enemy })
+    {
+        state.push_back(m_playerStartingBaseLocations[player]);
+    }
+
+    if (state == m_expansionState && !m_expansionOrder.empty())
+    {
+        return;
+    }
+    m_expansionState = state;
+
+    for (int player : { (int)Players::Self, (int)Players::Enemy })
+    {
+        std::vector<const BaseLocation *> & order = m_expansionOrder[player];
+        order.clear();
+
+        const BaseLocation * homeBase = m_playerStartingBaseLocations[player];
+        if (homeBase == nullptr)
+        {
+            continue;
+        }
+
+        for (const BaseLocation * base : m_baseLocationPtrs)
+        {
+            // skip mineral only and starting locations (TODO: fix this)
+            if (base->isMineralOnly() || base->isStartLocation())
+            {
+                continue;
+            }
+
+            // bases that aren't connected to home
+            if (getGroundDistance(homeBase, base) < 0)
+            {
+                continue;
+            }
+
+            order.push_back(base);
+        }
+
+        // stable, so equally distant bases keep the order of their ids
+        std::stable_sort(order.begin(), order.end(), [this, homeBase](const BaseLocation * a, const BaseLocation * b)
+        {
+            return getGroundDistance(homeBase, a) < getGroundDistance(homeBase, b);
+        });
+    }
+}
+
+void BaseLocationManager::trackResource(const Unit & resource, int baseID)
+{
+    TrackedResource tracked;
+    tracked.unit = resource;
+    tracked.baseID = baseID;
+    tracked.lastUpdate = m_resourceUpdate;
+
+    // nothing is known about a resource we haven't seen yet, it counts once it is visible
+    bool visible = resource.getUnitPtr()->display_type == sc2::Unit::Visible;
+    tracked.minerals = visible ? resource.getUnitPtr()->mineral_contents : 0;
+    tracked.gas = visible ? resource.getUnitPtr()->vespene_contents : 0;
+
+    m_baseLocationData[baseID].changeRemainingResources(tracked.minerals, tracked.gas);
+    m_resources[resource.getID()] = tracked;
 }
 
-void BaseLocationManager::updateGeysers(BaseLocation & baseToUpdate) {
-	std::vector<Unit> newGeysers;
-	for (Unit oldGeyser : baseToUpdate.getGeysers()) {
-		for (auto & geyser : m_bot.GetAllUnits()) {
-			if (oldGeyser.getPosition() == geyser.getPosition() && geyser.getType().isGeyser()) {
-				newGeysers.push_back(geyser);
-				break;
-			}
-		}
-	}
-	baseToUpdate.setGeysers(newGeysers);
+// one pass over the units finds the resources that appeared, changed or disappeared since the last frame,
+// only those touch the bases
+void BaseLocationManager::updateResources()
+{
+    m_resourceUpdate++;
+
+    for (auto & unit : m_bot.GetAllUnits())
+    {
+        if (!unit.getType().isMineral() && !unit.getType().isGeyser())
+        {
+            continue;
+        }
+
+        auto it = m_resources.find(unit.getID());
+        if (it != m_resources.end())
+        {
+            // the amount left only changes while someone is mining it, and we only know it while the resource is
+            // visible, a snapshot reports 0 so we keep the amount it had when last seen
+            TrackedResource & tracked = it->second;
+            tracked.lastUpdate = m_resourceUpdate;
+            if (unit.getUnitPtr()->display_type != sc2::Unit::Visible)
+            {
+                continue;
+            }
+
+            int minerals = unit.getUnitPtr()->mineral_contents;
+            int gas = unit.getUnitPtr()->vespene_contents;
+            if (minerals != tracked.minerals || gas != tracked.gas)
+            {
+                m_baseLocationData[tracked.baseID].changeRemainingResources(minerals - tracked.minerals, gas - tracked.gas);
+                tracked.minerals = minerals;
+                tracked.gas = gas;
+            }
+            continue;
+        }
+
+        // a new tag at the position of one of the starting resources, which happens when a snapshot comes into view
+        auto base = m_resourceBases.find(std::make_pair(unit.getPosition().x, unit.getPosition().y));
+        if (base != m_resourceBases.end())
+        {
+            m_baseLocationData[base->second].addResource(unit);
+            trackResource(unit, base->second);
+        }
+    }
+
+    // the resources we didn't see this time are mined out or were replaced by a new tag
+    for (auto it = m_resources.begin(); it != m_resources.end(); )
+    {
+        TrackedResource & tracked = it->second;
+        if (tracked.lastUpdate == m_resourceUpdate)
+        {
+            ++it;
+            continue;
+        }
+
+        BaseLocation & baseLocation = m_baseLocationData[tracked.baseID];
+        baseLocation.removeResource(tracked.unit);
+        baseLocation.changeRemainingResources(-tracked.minerals, -tracked.gas);
+        it = m_resources.erase(it);
+    }
 }
 
 BaseLocation * BaseLocationManager::getBaseLocation(const CCPosition & pos) const
@@ -284,9 +522,9 @@ BaseLocation * BaseLocationManager::getBaseLocation(const CCPosition & pos) cons
     if (!m_bot.Map().isValidPosition(pos)) { return nullptr; }
 
 #ifdef SC2API
-    return m_tileBaseLocations[(int)pos.x][(int)pos.y];
+    return m_tileBaseLocations.at((int)pos.x, (int)pos.y, nullptr);
 #else
-    return m_tileBaseLocations[pos.x / 32][pos.y / 32];
+    return m_tileBaseLocations.at(pos.x / 32, pos.y / 32, nullptr);
 #endif
 }
 
@@ -325,48 +563,69 @@ const std::set<const BaseLocation *> & BaseLocationManager::getOccupiedBaseLocat
     return m_occupiedBaseLocations.at(player);
 }
 
-const BaseLocation * BaseLocationManager::getNextExpansion(int player) const
+const BaseLocation * BaseLocationManager::getBaseLocationAt(const CCPosition & pos) const
 {
-    const BaseLocation * homeBase = getPlayerStartingBaseLocation(player);
-    const BaseLocation * closestBase = nullptr;
-    int minDistance = std::numeric_limits<int>::max();
+    return getBaseLocation(pos);
+}
 
-    CCPosition homeTile = homeBase->getPosition();
-    
-    for (auto & base : getBaseLocations())
-    {
-        // skip mineral only and starting locations (TODO: fix this)
-        if (base->isMineralOnly() || base->isStartLocation())
-        {
-            continue;
-        }
+const BaseLocation * BaseLocationManager::getBaseLocationAt(const CCTilePosition & tile) const
+{
+    return m_tileBaseLocations.at(tile.x, tile.y, nullptr);
+}
 
-        // get the tile position of the base
-        auto tile = base->getDepotPosition();
-        
-        UnitType base_type = Util::GetTownHall(m_bot.GetPlayerRace(Players::Self), m_bot);
-        bool canBuildBaseAtLocation = m_bot.Map().canBuildTypeAtPosition(tile.x, tile.y, base_type);
+int BaseLocationManager::getGroundDistance(const BaseLocation * from, const BaseLocation * to) const
+{
+    BOT_ASSERT(from != nullptr && to != nullptr, "Can't get the distance of a null base location");
 
-        if (!canBuildBaseAtLocation)
-        {
-            continue;
-        }
+    const size_t numBases = m_baseLocationData.size();
+    return m_baseDistances[from->getBaseId() * numBases + to->getBaseId()];
+}
 
-        // the base's distance from our main nexus
-        int distanceFromHome = homeBase->getGroundDistance(tile);
+const std::vector<int> & BaseLocationManager::getBaseDistanceMatrix() const
+{
+    return m_baseDistances;
+}
+
+std::vector<const BaseLocation *> BaseLocationManager::getExpansionOrder(int player) const
+{
+    std::vector<const BaseLocation *> order;
+
+    auto it = m_expansionOrder.find(player);
+    if (it == m_expansionOrder.end())
+    {
+        return order;
+    }
 
-        // if it is not connected, continue
-        if (distanceFromHome < 0)
+    for (const BaseLocation * base : it->second)
+    {
+        if (!base->isOccupiedByPlayer(Players::Self) && !base->isOccupiedByPlayer(Players::Enemy))
         {
-            continue;
+            order.push_back(base);
         }
+    }
 
-        if (!closestBase || distanceFromHome < minDistance)
+    return order;
+}
+
+const BaseLocation * BaseLocationManager::getNextExpansion(int player) const
+{
+    auto it = m_expansionOrder.find(player);
+    if (it == m_expansionOrder.end())
+    {
+        return nullptr;
+    }
+
+    UnitType baseType = Util::GetTownHall(m_bot.GetPlayerRace(Players::Self), m_bot);
+
+    // the bases are already sorted by distance, so the first one we can build on is the closest
+    for (const BaseLocation * base : it->second)
+    {
+        auto tile = base->getDepotPosition();
+        if (m_bot.Map().canBuildTypeAtPosition(tile.x, tile.y, baseType))
         {
-            closestBase = base;
-            minDistance = distanceFromHome;
+            return base;
         }
     }
 
-    return closestBase;
+    return nullptr;
 }
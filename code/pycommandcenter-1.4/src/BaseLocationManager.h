@@ -1,11 +1,23 @@
 #pragma once
 
 #include "BaseLocation.h"
+#include "TileGrid.h"
+#include <unordered_map>
 
 class IDABot;
 
 class BaseLocationManager
 {
+    // a mineral field or geyser of one of the bases, with what it held when last seen
+    struct TrackedResource
+    {
+        Unit        unit;
+        int         baseID;
+        int         minerals;
+        int         gas;
+        uint32_t    lastUpdate;
+    };
+
     IDABot & m_bot;
 
     std::vector<BaseLocation>                       m_baseLocationData;
@@ -13,15 +25,30 @@ class BaseLocationManager
     std::vector<const BaseLocation *>               m_startingBaseLocations;
     std::map<int, const BaseLocation *>             m_playerStartingBaseLocations;
     std::map<int, std::set<const BaseLocation *>>   m_occupiedBaseLocations;
-    std::vector<std::vector<BaseLocation *>>        m_tileBaseLocations;
+    TileGrid<BaseLocation *>                        m_tileBaseLocations;
+    std::vector<int>                                m_baseDistances;    // ground distance from every base to the depot of every base, row by row
+    std::map<int, std::vector<const BaseLocation *>> m_expansionOrder;  // connected bases closest to the start location of every player first
+    std::vector<const BaseLocation *>               m_expansionState;   // the start locations the orders were made for
+    std::unordered_map<CCUnitID, TrackedResource>   m_resources;        // the resources of all bases by tag
+    std::map<std::pair<float, float>, int>          m_resourceBases;    // the base of every resource position seen at the start of the game
+    uint32_t                                        m_resourceUpdate;
+    bool                                            m_groundClustering;
 
     BaseLocation * getBaseLocation(const CCPosition & pos) const;
+    void updateExpansionOrder();
+    std::vector<std::vector<Unit>> clusterResources() const;
+    void trackResource(const Unit & resource, int baseID);
+    void updateResources();
 
 public:
 
     BaseLocationManager(IDABot & bot);
     
     void onStart();
+
+    // whether resources are only put in the same base if they are ground connected, set before the game starts
+    void setGroundClustering(bool groundClustering);
+    bool getGroundClustering() const;
     void onFrame();
     void drawBaseLocations();
 
@@ -32,9 +59,16 @@ public:
     
     const BaseLocation * getNextExpansion(int player) const;
 
-private:
-	void updateMinerals(BaseLocation & baseToUpdate);
-	void updateGeysers(BaseLocation & baseToUpdate);
+    // the base location whose area contains the position, nullptr if there is none
+    const BaseLocation * getBaseLocationAt(const CCPosition & pos) const;
+    const BaseLocation * getBaseLocationAt(const CCTilePosition & tile) const;
 
+    // ground distance from the resources of one base to the depot position of the other at the
+    // start of the game, -1 if they aren't connected
+    int getGroundDistance(const BaseLocation * from, const BaseLocation * to) const;
+    // the distances as a matrix of base ids, row by row
+    const std::vector<int> & getBaseDistanceMatrix() const;
 
+    // the bases nobody occupies that can be reached from the start location of the player, closest first
+    std::vector<const BaseLocation *> getExpansionOrder(int player) const;
 };
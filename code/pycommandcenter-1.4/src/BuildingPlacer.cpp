@@ -3,32 +3,188 @@
 #include "IDABot.h"
 #include "Util.h"
 
+// how many candidate locations are sent to the game in one placement query
+const size_t PlacementBatchSize = 32;
+
+namespace
+{
+    // fills sums, one row and column larger than tiles, with the summed-area table of the set tiles
+    void buildSums(const TileGrid<bool> & tiles, TileGrid<int> & sums)
+    {
+        const int width = tiles.width();
+        const int height = tiles.height();
+        sums.reset(width + 1, height + 1, 0);
+        for (int y=0; y<height; ++y)
+        {
+            int rowSum = 0;
+            for (int x=0; x<width; ++x)
+            {
+                rowSum += tiles.get(x, y) ? 1 : 0;
+                sums.set(x + 1, y + 1, sums.get(x + 1, y) + rowSum);
+            }
+        }
+    }
+
+    // the number of tiles with x1 <= x < x2 and y1 <= y < y2 counted in a summed-area table,
+    // the rectangle has to be inside the grid the table was built from
+    int countInRectangle(const TileGrid<int> & sums, int x1, int y1, int x2, int y2)
+    {
+        return sums.get(x2, y2) - sums.get(x1, y2) - sums.get(x2, y1) + sums.get(x1, y1);
+    }
+}
+
 BuildingPlacer::BuildingPlacer(IDABot & bot)
     : m_bot(bot)
+    , m_reserveUpdate(0)
+    , m_reserveGeneration(0)
+    , m_placementCacheGeneration(0)
+    , m_placementCacheWalkableVersion(0)
+    , m_blockedDirty(true)
+    , m_blockedWalkableVersion(0)
 {
 
 }
 
 void BuildingPlacer::onStart()
 {
-    m_reserveMap = std::vector< std::vector<bool> >(m_bot.Map().width(), std::vector<bool>(m_bot.Map().height(), false));
+    m_reserveMap.reset(m_bot.Map().width(), m_bot.Map().height(), false);
+    m_unitCount.reset(m_bot.Map().width(), m_bot.Map().height(), 0);
+    m_agentReserved.reset(m_bot.Map().width(), m_bot.Map().height(), false);
+    m_unitFootprints.clear();
+    m_blockedDirty = true;
+    m_reserveGeneration++;
+
+    computeTownHallTiles();
+}
+
+void BuildingPlacer::computeTownHallTiles()
+{
+    const int width = m_bot.Map().width();
+    const int height = m_bot.Map().height();
+
+    // the same rectangle the overlap checks used to compare against, edges included
+    const UnitType townHall = Util::GetTownHall(m_bot.GetPlayerRace(Players::Self), m_bot);
+    TileGrid<bool> townHallTiles(width, height, false);
+
+    for (const BaseLocation * base : m_bot.Bases().getBaseLocations())
+    {
+        int bx1 = (int)base->getDepotPosition().x;
+        int by1 = (int)base->getDepotPosition().y;
+        int bx2 = bx1 + townHall.tileWidth();
+        int by2 = by1 + townHall.tileHeight();
+
+        for (int y = std::max(by1, 0); y <= by2 && y < height; y++)
+        {
+            for (int x = std::max(bx1, 0); x <= bx2 && x < width; x++)
+            {
+                townHallTiles.set(x, y, true);
+            }
+        }
+    }
+
+    buildSums(townHallTiles, m_townHallSums);
+}
+
+bool BuildingPlacer::overlapsTownHallTiles(int x1, int y1, int x2, int y2) const
+{
+    // only tiles on the map are ever kept free
+    x1 = std::max(x1, 0);
+    y1 = std::max(y1, 0);
+    x2 = std::min(x2 + 1, m_townHallSums.width() - 1);
+    y2 = std::min(y2 + 1, m_townHallSums.height() - 1);
+
+    if (x1 >= x2 || y1 >= y2)
+    {
+        return false;
+    }
+
+    return countInRectangle(m_townHallSums, x1, y1, x2, y2) > 0;
 }
 
 void BuildingPlacer::updateReserved(const std::vector<Unit> & units)
 {
-	freeAllTiles();
-	
-	for (Unit unit : units) {
-		reserveTiles(unit.getTilePosition().x, unit.getTilePosition().y, unit.getType().tileWidth(), unit.getType().tileHeight());
-	}
+    m_reserveUpdate++;
+
+    // only units that are new or have moved to another tile change the map
+    for (const Unit & unit : units)
+    {
+        int width = unit.getType().tileWidth();
+        int height = unit.getType().tileHeight();
+
+        UnitFootprint footprint;
+        footprint.x = unit.getTilePosition().x - (int)std::ceil((width - 1.0) / 2);
+        footprint.y = unit.getTilePosition().y - (int)std::ceil((height - 1.0) / 2);
+        footprint.width = width;
+        footprint.height = height;
+        footprint.lastSeen = m_reserveUpdate;
+
+        auto it = m_unitFootprints.find(unit.getID());
+        if (it != m_unitFootprints.end())
+        {
+            UnitFootprint & old = it->second;
+            old.lastSeen = m_reserveUpdate;
+            if (old.x == footprint.x && old.y == footprint.y && old.width == footprint.width && old.height == footprint.height)
+            {
+                continue;
+            }
+
+            addUnitFootprint(old, -1);
+            old = footprint;
+        }
+        else
+        {
+            m_unitFootprints[unit.getID()] = footprint;
+        }
+
+        addUnitFootprint(footprint, 1);
+    }
+
+    // free the tiles of the units that weren't seen this time
+    for (auto it = m_unitFootprints.begin(); it != m_unitFootprints.end(); )
+    {
+        if (it->second.lastSeen == m_reserveUpdate)
+        {
+            ++it;
+            continue;
+        }
+
+        addUnitFootprint(it->second, -1);
+        it = m_unitFootprints.erase(it);
+    }
+}
+
+void BuildingPlacer::addUnitFootprint(const UnitFootprint & footprint, int change)
+{
+    for (int y = std::max(footprint.y, 0); y < footprint.y + footprint.height && y < m_unitCount.height(); y++)
+    {
+        for (int x = std::max(footprint.x, 0); x < footprint.x + footprint.width && x < m_unitCount.width(); x++)
+        {
+            m_unitCount.set(x, y, (uint16_t)(m_unitCount.get(x, y) + change));
+            updateReservedTile(x, y);
+        }
+    }
+}
+
+void BuildingPlacer::updateReservedTile(int x, int y)
+{
+    bool reserved = m_unitCount.get(x, y) > 0 || m_agentReserved.get(x, y);
+    if (reserved != m_reserveMap.get(x, y))
+    {
+        m_reserveMap.set(x, y, reserved);
+        m_blockedDirty = true;
+        m_reserveGeneration++;
+    }
 }
 
 void BuildingPlacer::freeAllTiles() {
-	for (int x = 0; x < m_reserveMap.size(); x++) {
-		for (int y = 0; y < m_reserveMap[x].size(); y++) {
-			m_reserveMap[x][y] = false;
-		}
-	}
+	m_reserveMap.fill(false);
+	m_unitCount.fill(0);
+	m_agentReserved.fill(false);
+
+	// the units still standing around are reserved again by the next update
+	m_unitFootprints.clear();
+	m_blockedDirty = true;
+	m_reserveGeneration++;
 }
 
 bool BuildingPlacer::isInResourceBox(int tileX, int tileY) const
@@ -50,15 +206,9 @@ bool BuildingPlacer::canBuildHere(int bx, int by, const UnitType & type) const
 	int ydelta = (int)std::ceil((height - 1.0) / 2);
 
     // check the reserve map, that it is a valid tile and not a wall
-    for (int x = bx - xdelta; x < bx + width - xdelta; x++)
+    if (!isRectangleFree(bx - xdelta, by - ydelta, bx + width - xdelta, by + height - ydelta))
     {
-        for (int y = by - ydelta; y < by + height - ydelta; y++)
-        {
-            if (!m_bot.Map().isValidTile(x, y) || isReserved(x, y) || !m_bot.Map().isWalkable(x, y))
-            {
-                return false;
-            }
-        }
+        return false;
     }
 
     // if it overlaps a base location return false
@@ -81,15 +231,9 @@ bool BuildingPlacer::canBuildHereWithSize(int bx, int by, int width, int height)
 	int ydelta = (int)std::ceil((height - 1.0) / 2);
 
 	// check the reserve map, that it is a valid tile and not a wall
-	for (int x = bx - xdelta; x < bx + width - xdelta; x++)
+	if (!isRectangleFree(bx - xdelta, by - ydelta, bx + width - xdelta, by + height - ydelta))
 	{
-		for (int y = by - ydelta; y < by + height - ydelta; y++)
-		{
-			if (!m_bot.Map().isValidTile(x, y) || isReserved(x, y) || !m_bot.Map().isWalkable(x, y))
-			{
-				return false;
-			}
-		}
+		return false;
 	}
 
 	// Check so it doesn't overlap with a baselocation
@@ -100,31 +244,16 @@ bool BuildingPlacer::canBuildHereWithSize(int bx, int by, int width, int height)
 	int tx2 = tx1 + width - xdelta;
 	int ty2 = ty1 + height - ydelta;
 
-	// for each base location
-	for (const BaseLocation * base : m_bot.Bases().getBaseLocations())
-	{
-		// dimensions of the base location
-		int bx1 = (int)base->getDepotPosition().x;
-		int by1 = (int)base->getDepotPosition().y;
-		int bx2 = bx1 + Util::GetTownHall(m_bot.GetPlayerRace(Players::Self), m_bot).tileWidth();
-		int by2 = by1 + Util::GetTownHall(m_bot.GetPlayerRace(Players::Self), m_bot).tileHeight();
-
-		// conditions for non-overlap are easy
-		bool noOverlap = (tx2 < bx1) || (tx1 > bx2) || (ty2 < by1) || (ty1 > by2);
-
-		// If there is overlap, return false
-		if (!noOverlap)
-		{
-			return false;
-		}
-	}
-
-	// otherwise there is no overlap
-	return true;
+	return !overlapsTownHallTiles(tx1, ty1, tx2, ty2);
 }
 
 //returns true if we can build this type of unit here with the specified amount of space.
 bool BuildingPlacer::canBuildHereWithSpace(int bx, int by, const UnitType & type, int buildDist) const
+{
+    return canBuildHereWithSpaceLocally(bx, by, type, buildDist) && m_bot.Map().canBuildTypeAtPosition(bx, by, type);
+}
+
+bool BuildingPlacer::canBuildHereWithSpaceLocally(int bx, int by, const UnitType & type, int buildDist) const
 {
     //if we can't build here, we of course can't build here with space
     if (!canBuildHere(bx, by, type))
@@ -155,25 +284,10 @@ bool BuildingPlacer::canBuildHereWithSpace(int bx, int by, const UnitType & type
         return false;
     }
 
-	if (!m_bot.Map().canBuildTypeAtPosition(bx, by, type))
-	{
-		return false;
-	}
-
-
-    // if we can't build here, or space is reserved, or it's in the resource box, we can't build here
-    for (int x = startx; x < endx; x++)
+    // if we can't build here, or space is reserved, or it's a wall, we can't build here
+    if (!type.isRefinery() && !isRectangleFree(startx, starty, endx, endy))
     {
-        for (int y = starty; y < endy; y++)
-        {
-            if (!type.isRefinery())
-            {
-                if (!buildable(type, x, y) || isReserved(x, y) || !m_bot.Map().isWalkable(x, y)) // added isWalkabale in order to check towards walls
-                {
-                    return false;
-                }
-            }
-        }
+        return false;
     }
 
     return true;
@@ -182,26 +296,73 @@ bool BuildingPlacer::canBuildHereWithSpace(int bx, int by, const UnitType & type
 // BuildDist is the distance from the position where the building is gonna be placed.
 
 CCTilePosition BuildingPlacer::getBuildLocationNear(const CCTilePosition & p, const UnitType & t, int buildDist, size_t search_count) const
+{
+    if (m_placementCacheGeneration != m_reserveGeneration || m_placementCacheWalkableVersion != m_bot.Map().getWalkableVersion())
+    {
+        m_placementCache.clear();
+        m_placementCacheGeneration = m_reserveGeneration;
+        m_placementCacheWalkableVersion = m_bot.Map().getWalkableVersion();
+    }
+
+    // the game also refuses locations for reasons the reserve map doesn't know about, like missing creep or power,
+    // which come and go without any tile changing, so a failed search is repeated on the next frame
+    const PlacementKey key((uint32_t)t.getAPIUnitType(), p.x, p.y, buildDist, search_count);
+    auto cached = m_placementCache.find(key);
+    if (cached != m_placementCache.end() && (cached->second.found || cached->second.frame == m_bot.GetCurrentFrame()))
+    {
+        return cached->second.position;
+    }
+
+    PlacementResult & result = m_placementCache[key];
+    result.position = findBuildLocationNear(p, t, buildDist, search_count, result.found);
+    result.frame = m_bot.GetCurrentFrame();
+    return result.position;
+}
+
+CCTilePosition BuildingPlacer::findBuildLocationNear(const CCTilePosition & p, const UnitType & t, int buildDist, size_t search_count, bool & found) const
 {
     //Timer t;
     //t.start();
 
-    // get the precomputed vector of tile positions which are sorted closes to this location
-    auto & closestToBuilding = m_bot.Map().getClosestTilesTo(p);
+    // get the precomputed distance map, whose tiles are sorted closest to this location
+    auto closestToBuilding = m_bot.Map().getDistanceMap(p);
 
     //double ms1 = t.getElapsedTimeInMilliSec();
 
-    // iterate through the list until we've found a suitable location
-    for (size_t i(0); i < closestToBuilding.size() && (search_count == 0 || i < search_count); ++i)
+    // iterate through the list, collecting the tiles that pass our own checks and asking the game about
+    // them a batch at a time, the first tile of a batch the game accepts is the closest suitable location
+    const size_t numTiles = search_count == 0 ? closestToBuilding->getNumSortedTiles() : std::min(search_count, closestToBuilding->getNumSortedTiles());
+    std::vector<CCTilePosition> candidates;
+
+    for (size_t i(0); i < numTiles; ++i)
     {
-        auto & pos = closestToBuilding[i];
+        CCTilePosition pos = closestToBuilding->getSortedTile(i);
+
+        if (canBuildHereWithSpaceLocally(pos.x, pos.y, t, buildDist))
+        {
+            candidates.push_back(pos);
+        }
+
+        if (candidates.size() < PlacementBatchSize && i + 1 < numTiles)
+        {
+            continue;
+        }
 
-        if (canBuildHereWithSpace(pos.x, pos.y, t, buildDist))
+        if (!candidates.empty())
         {
-            //double ms = t.getElapsedTimeInMilliSec();
-            //printf("Building Placer Took %d iterations, lasting %lf ms @ %lf iterations/ms, %lf setup ms\n", (int)i, ms, (i / ms), ms1);
+            std::vector<bool> valid = m_bot.Map().canBuildTypeAtPositions(candidates, t);
+            for (size_t c(0); c < candidates.size(); ++c)
+            {
+                if (valid[c])
+                {
+                    //double ms = t.getElapsedTimeInMilliSec();
+                    //printf("Building Placer Took %d iterations, lasting %lf ms @ %lf iterations/ms, %lf setup ms\n", (int)i, ms, (i / ms), ms1);
 
-            return pos;
+                    found = true;
+                    return candidates[c];
+                }
+            }
+            candidates.clear();
         }
     }
 
@@ -209,6 +370,7 @@ CCTilePosition BuildingPlacer::getBuildLocationNear(const CCTilePosition & p, co
     //printf("Building Placer Failure: %s - Took %lf ms\n", b.type.getName().c_str(), ms);
 	std::cout << "Warning! Could not find valid placement for " << t.getName() << " near (" << p.x << ", " << p.y << "). Returning (0, 0) instead.";
 
+    found = false;
     return CCTilePosition(0, 0);
 }
 
@@ -230,27 +392,7 @@ bool BuildingPlacer::tileOverlapsBaseLocation(int x, int y, UnitType type) const
     int tx2 = tx1 + type.tileWidth() - xdelta;
     int ty2 = ty1 + type.tileHeight() - ydelta;
 
-    // for each base location
-    for (const BaseLocation * base : m_bot.Bases().getBaseLocations())
-    {
-        // dimensions of the base location
-        int bx1 = (int)base->getDepotPosition().x;
-        int by1 = (int)base->getDepotPosition().y;
-        int bx2 = bx1 + Util::GetTownHall(m_bot.GetPlayerRace(Players::Self), m_bot).tileWidth();
-        int by2 = by1 + Util::GetTownHall(m_bot.GetPlayerRace(Players::Self), m_bot).tileHeight();
-
-        // conditions for non-overlap are easy
-        bool noOverlap = (tx2 < bx1) || (tx1 > bx2) || (ty2 < by1) || (ty1 > by2);
-
-        // if the reverse is true, return true
-        if (!noOverlap)
-        {
-            return true;
-        }
-    }
-
-    // otherwise there is no overlap
-    return false;
+    return overlapsTownHallTiles(tx1, ty1, tx2, ty2);
 }
 
 bool BuildingPlacer::buildable(const UnitType & type, int x, int y) const
@@ -269,17 +411,15 @@ bool BuildingPlacer::buildable(const UnitType & type, int x, int y) const
 void BuildingPlacer::reserveTiles(int bx, int by, int width, int height)
 {
 	// THIS is never called, that's why spacing doesnt work correctly
-    int rwidth = (int)m_reserveMap.size();
-    int rheight = (int)m_reserveMap[0].size();
-
 	int xdelta = (int)std::ceil((width - 1.0) / 2);
 	int ydelta = (int)std::ceil((height - 1.0) / 2);
 
-    for (int x = bx - xdelta; x < bx + width - xdelta && x < rwidth; x++)
+    for (int y = std::max(by - ydelta, 0); y < by + height - ydelta && y < m_reserveMap.height(); y++)
     {
-        for (int y = by - ydelta; y < by + height - ydelta && y < rheight; y++)
+        for (int x = std::max(bx - xdelta, 0); x < bx + width - xdelta && x < m_reserveMap.width(); x++)
         {
-            m_reserveMap[x][y] = true;
+            m_agentReserved.set(x, y, true);
+            updateReservedTile(x, y);
         }
     }
 }
@@ -288,14 +428,11 @@ void BuildingPlacer::drawReservedTiles()
 {
 	// Why is there a return here? Should we not use the function? /Hannes Jmtner
     return;
-    int rwidth = (int)m_reserveMap.size();
-    int rheight = (int)m_reserveMap[0].size();
-
-    for (int x = 0; x < rwidth; ++x)
+    for (int y = 0; y < m_reserveMap.height(); ++y)
     {
-        for (int y = 0; y < rheight; ++y)
+        for (int x = 0; x < m_reserveMap.width(); ++x)
         {
-            if (m_reserveMap[x][y] || isInResourceBox(x, y))
+            if (m_reserveMap.get(x, y) || isInResourceBox(x, y))
             {
                 m_bot.Map().drawTile(x, y, CCColor(255, 255, 0));
             }
@@ -305,17 +442,15 @@ void BuildingPlacer::drawReservedTiles()
 
 void BuildingPlacer::freeTiles(int bx, int by, int width, int height)
 {
-    int rwidth = (int)m_reserveMap.size();
-    int rheight = (int)m_reserveMap[0].size();
-
 	int xdelta = (int)std::ceil((width - 1.0) / 2);
 	int ydelta = (int)std::ceil((height - 1.0) / 2);
 
-    for (int x = bx - xdelta; x < bx + width - xdelta && x < rwidth; x++)
+    for (int y = std::max(by - ydelta, 0); y < by + height - ydelta && y < m_reserveMap.height(); y++)
     {
-        for (int y = by - ydelta; y < by + height - ydelta && y < rheight; y++)
+        for (int x = std::max(bx - xdelta, 0); x < bx + width - xdelta && x < m_reserveMap.width(); x++)
         {
-            m_reserveMap[x][y] = false;
+            m_agentReserved.set(x, y, false);
+            updateReservedTile(x, y);
         }
     }
 }
@@ -372,13 +507,54 @@ CCTilePosition BuildingPlacer::getRefineryPosition()
 
 bool BuildingPlacer::isReserved(int x, int y) const
 {
-    int rwidth = (int)m_reserveMap.size();
-    int rheight = (int)m_reserveMap[0].size();
-    if (x < 0 || y < 0 || x >= rwidth || y >= rheight)
+    return m_reserveMap.at(x, y, false);
+}
+
+void BuildingPlacer::updateBlocked() const
+{
+    const TileGrid<bool> & walkable = m_bot.Map().getWalkableGrid();
+    if (!m_blockedDirty && m_blockedWalkableVersion == m_bot.Map().getWalkableVersion())
+    {
+        return;
+    }
+
+    // both grids are packed the same way, so the blocked tiles can be combined a word at a time
+    const int width = m_reserveMap.width();
+    const int height = m_reserveMap.height();
+    m_blocked.reset(width, height);
+
+    if (walkable.width() == width && walkable.height() == height)
+    {
+        for (size_t i=0; i<m_blocked.wordCount(); ++i)
+        {
+            m_blocked.words()[i] = m_reserveMap.words()[i] | ~walkable.words()[i];
+        }
+    }
+    else
+    {
+        m_blocked.fill(true);
+    }
+
+    buildSums(m_blocked, m_blockedSums);
+
+    m_blockedDirty = false;
+    m_blockedWalkableVersion = m_bot.Map().getWalkableVersion();
+}
+
+bool BuildingPlacer::isRectangleFree(int x1, int y1, int x2, int y2) const
+{
+    if (x1 >= x2 || y1 >= y2)
+    {
+        return true;
+    }
+
+    if (x1 < 0 || y1 < 0 || x2 > m_reserveMap.width() || y2 > m_reserveMap.height())
     {
         return false;
     }
 
-    return m_reserveMap[x][y];
+    updateBlocked();
+
+    return countInRectangle(m_blockedSums, x1, y1, x2, y2) == 0;
 }
 
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "Common.h"
+#include "TileGrid.h"
+#include <map>
+#include <tuple>
 
 class IDABot;
 class BaseLocation;
@@ -9,34 +12,92 @@ class Unit;
 
 class BuildingPlacer
 {
+    // the tiles a unit stands on, and the last update it was seen in
+    struct UnitFootprint
+    {
+        int x;
+        int y;
+        int width;
+        int height;
+        int lastSeen;
+    };
+
+    // a result of getBuildLocationNear, a search that found nothing is only trusted for the frame it was made in
+    struct PlacementResult
+    {
+        CCTilePosition position;
+        bool found;
+        int frame;
+    };
+
+    // unit type, anchor tile x and y, build distance and search count of a getBuildLocationNear call
+    typedef std::tuple<uint32_t, int, int, int, size_t> PlacementKey;
+
     IDABot & m_bot;
 
-    std::vector< std::vector<bool> > m_reserveMap;
+    TileGrid<bool> m_reserveMap;            // tiles that are either occupied by a unit or reserved with reserveTiles
+    TileGrid<uint16_t> m_unitCount;         // the number of units standing on every tile
+    TileGrid<bool> m_agentReserved;         // tiles reserved with reserveTiles, kept until they are freed
+    std::map<CCUnitID, UnitFootprint> m_unitFootprints;
+    int m_reserveUpdate;
+    uint32_t m_reserveGeneration;           // bumped whenever a tile of the reserve map changes
+
+    // the results of getBuildLocationNear, thrown away once the reserve map or the walkable tiles change
+    mutable std::map<PlacementKey, PlacementResult> m_placementCache;
+    mutable uint32_t        m_placementCacheGeneration;
+    mutable uint32_t        m_placementCacheWalkableVersion;
+
+    // the tiles that are reserved or unwalkable, and the number of them above and to the left of every tile corner,
+    // rebuilt when the reserve map or the walkable tiles have changed since the last check
+    mutable TileGrid<bool>  m_blocked;
+    mutable TileGrid<int>   m_blockedSums;
+    mutable bool            m_blockedDirty;
+    mutable uint32_t        m_blockedWalkableVersion;
+
+    // the number of tiles kept free for a town hall at some base location above and to the left of every tile corner,
+    // built once in onStart since the base locations never change
+    TileGrid<int>           m_townHallSums;
 
     // queries for various BuildingPlacer data
     bool buildable(const UnitType & type, int x, int y) const;
     bool isReserved(int x, int y) const;
+    void updateBlocked() const;
+    void addUnitFootprint(const UnitFootprint & footprint, int change);
+    void updateReservedTile(int x, int y);
+    // whether all tiles with x1 <= x < x2 and y1 <= y < y2 are on the map, walkable and not reserved
+    bool isRectangleFree(int x1, int y1, int x2, int y2) const;
     bool isInResourceBox(int x, int y) const;
     bool tileOverlapsBaseLocation(int x, int y, UnitType type) const;
+    // whether any tile with x1 <= x <= x2 and y1 <= y <= y2 is kept free for a town hall
+    bool overlapsTownHallTiles(int x1, int y1, int x2, int y2) const;
+    void computeTownHallTiles();
+    // the uncached search of getBuildLocationNear
+    CCTilePosition findBuildLocationNear(const CCTilePosition & p, const UnitType & type, int buildDist, size_t search_count, bool & found) const;
 
 public:
 
     BuildingPlacer(IDABot & bot);
 
     void onStart();
+	// reserves the tiles of units that appeared or moved and frees the tiles of units that left or are gone
 	void updateReserved(const std::vector<Unit> & units);
+	// frees every tile, including the ones reserved with reserveTiles
 	void freeAllTiles();
 
     // determines whether we can build at a given location
     bool canBuildHere(int bx, int by, const UnitType & type) const;
 	bool canBuildHereWithSize(int bx, int by, int width, int height);
     bool canBuildHereWithSpace(int bx, int by, const UnitType & type, int buildDist) const;
+    // all the checks of canBuildHereWithSpace except asking the game, which is by far the slowest one
+    bool canBuildHereWithSpaceLocally(int bx, int by, const UnitType & type, int buildDist) const;
 
-    // returns a build location near a building's desired location
+    // returns a build location near a building's desired location, repeated calls are answered from a cache until
+    // the reserve map or the walkable tiles change
     CCTilePosition getBuildLocationNear(const CCTilePosition & p, const UnitType & type, int buildDist, size_t search_count = 1000) const;
 
     void drawReservedTiles();
 
+    // reservations made here stay until they are freed, freeing tiles a unit stands on only takes effect once it leaves
     void reserveTiles(int x, int y, int width, int height);
     void freeTiles(int x, int y, int width, int height);
     CCTilePosition getRefineryPosition();
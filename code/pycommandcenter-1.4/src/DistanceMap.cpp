@@ -6,7 +6,19 @@ const size_t LegalActions = 4;
 const int actionX[LegalActions] = {1, -1, 0, 0};
 const int actionY[LegalActions] = {0, 0, 1, -1};
 
+// the four straight moves followed by the four diagonal ones
+const size_t OctileActions = 8;
+const int octileX[OctileActions] = {1, -1, 0, 0, 1, 1, -1, -1};
+const int octileY[OctileActions] = {0, 0, 1, -1, 1, -1, 1, -1};
+
+const uint16_t DistanceMap::Unreachable;
+const int DistanceMap::OctileStraightCost;
+const int DistanceMap::OctileDiagonalCost;
+
 DistanceMap::DistanceMap() 
+    : m_width(0)
+    , m_height(0)
+    , m_metric(DistanceMetric::FourConnected)
 {
     
 }
@@ -14,7 +26,14 @@ DistanceMap::DistanceMap()
 int DistanceMap::getDistance(int tileX, int tileY) const
 { 
     BOT_ASSERT(tileX < m_width && tileY < m_height, "Index out of range: X = %d, Y = %d", tileX, tileY);
-    return m_dist[tileX][tileY]; 
+    uint16_t dist = m_dist.at(tileX, tileY, Unreachable);
+    if (dist == Unreachable)
+    {
+        return -1;
+    }
+
+    // octile distances are stored in fifths of a tile, round them to whole tiles
+    return m_metric == DistanceMetric::Octile ? (dist + OctileStraightCost / 2) / OctileStraightCost : dist; 
 }
 
 int DistanceMap::getDistance(const CCTilePosition & pos) const
@@ -31,55 +50,244 @@ int DistanceMap::getDistance(const CCPosition & pos) const
 #endif
 }
 
+int DistanceMap::getDistanceOnto(const MapTools & map, const CCTilePosition & pos) const
+{
+    // only walkable ground under a building is stepped onto, cliffs and other unwalkable terrain stay unreachable
+    if (map.isWalkable(pos) || pos == m_startTile || !m_dist.isValid(pos.x, pos.y)
+        || !map.isBlocked(pos.x, pos.y) || !map.isTerrainWalkable(pos))
+    {
+        return getDistance(pos);
+    }
+
+    uint16_t dist = getStepDistance(map, pos.x, pos.y);
+    if (dist == Unreachable)
+    {
+        return -1;
+    }
+
+    return m_metric == DistanceMetric::Octile ? (dist + OctileStraightCost / 2) / OctileStraightCost : dist;
+}
+
+uint16_t DistanceMap::getStepDistance(const MapTools & map, int tileX, int tileY) const
+{
+    bool octile = m_metric == DistanceMetric::Octile;
+    size_t numActions = octile ? OctileActions : LegalActions;
+    int best = Unreachable;
+
+    for (size_t a=0; a<numActions; ++a)
+    {
+        int fromX = tileX - octileX[a];
+        int fromY = tileY - octileY[a];
+
+        // other tiles than the start that aren't walkable are never left, even if an older map gave them a distance
+        uint16_t fromDist = m_dist.at(fromX, fromY, Unreachable);
+        if (fromDist == Unreachable || (!map.isWalkable(fromX, fromY) && !(fromX == m_startTile.x && fromY == m_startTile.y)))
+        {
+            continue;
+        }
+
+        // a diagonal step may not cut the corner of a blocked tile
+        bool diagonal = octileX[a] != 0 && octileY[a] != 0;
+        if (diagonal && (!map.isWalkable(tileX, fromY) || !map.isWalkable(fromX, tileY)))
+        {
+            continue;
+        }
+
+        int cost = !octile ? 1 : (diagonal ? OctileDiagonalCost : OctileStraightCost);
+        best = std::min(best, fromDist + cost);
+    }
+
+    // as in the searches, four connected distances are capped just below Unreachable and longer octile ones are unreachable
+    if (!octile && best < Unreachable)
+    {
+        return (uint16_t)std::min(best, Unreachable - 1);
+    }
+
+    return (uint16_t)std::min(best, (int)Unreachable);
+}
+
+DistanceMetric DistanceMap::getMetric() const
+{
+    return m_metric;
+}
+
+const TileGrid<uint16_t> & DistanceMap::getDistanceGrid() const
+{
+    return m_dist;
+}
+
 const std::vector<CCTilePosition> & DistanceMap::getSortedTiles() const
 {
-    return m_sortedTiles;
+    // several threads may ask at once, the first one to finish the list wins
+    auto tiles = std::atomic_load(&m_sortedTiles);
+    if (!tiles)
+    {
+        auto built = std::make_shared<std::vector<CCTilePosition>>();
+        built->reserve(m_sortedIndices.size());
+        for (size_t i(0); i < m_sortedIndices.size(); ++i)
+        {
+            built->push_back(getSortedTile(i));
+        }
+
+        std::shared_ptr<const std::vector<CCTilePosition>> expected;
+        tiles = built;
+        if (!std::atomic_compare_exchange_strong(&m_sortedTiles, &expected, tiles))
+        {
+            tiles = expected;
+        }
+    }
+
+    return *tiles;
 }
 
-// Computes m_dist[x][y] = ground distance from (startX, startY) to (x,y)
-// Uses BFS, since the map is quite large and DFS may cause a stack overflow
-void DistanceMap::computeDistanceMap(IDABot & m_bot, const CCTilePosition & startTile)
+size_t DistanceMap::getNumSortedTiles() const
+{
+    return m_sortedIndices.size();
+}
+
+CCTilePosition DistanceMap::getSortedTile(size_t i) const
+{
+    uint32_t index = m_sortedIndices[i];
+    return CCTilePosition(index % m_width, index / m_width);
+}
+
+// Computes the ground distance from startTile to every tile on the map
+void DistanceMap::computeDistanceMap(IDABot & m_bot, const CCTilePosition & startTile, DistanceMetric metric)
+{
+    computeDistanceMap(m_bot.Map(), startTile, metric);
+}
+
+void DistanceMap::computeDistanceMap(const MapTools & map, const CCTilePosition & startTile, DistanceMetric metric)
 {
     m_startTile = startTile;
-    m_width = m_bot.Map().width();
-    m_height = m_bot.Map().height();
-    m_dist = std::vector<std::vector<int>>(m_width, std::vector<int>(m_height, -1));
-    m_sortedTiles.reserve(m_width * m_height);
+    m_metric = metric;
+    m_width = map.width();
+    m_height = map.height();
+    m_dist.reset(m_width, m_height, Unreachable);
+    m_sortedIndices.clear();
+    std::atomic_store(&m_sortedTiles, std::shared_ptr<const std::vector<CCTilePosition>>());
 
-    // the fringe for the BFS we will perform to calculate distances
-    std::vector<CCTilePosition> fringe;
-    fringe.reserve(m_width * m_height);
-    fringe.push_back(startTile);
-    m_sortedTiles.push_back(startTile);
+    if (!m_dist.isValid(startTile.x, startTile.y))
+    {
+        return;
+    }
 
-    m_dist[(int)startTile.x][(int)startTile.y] = 0;
+    m_sortedIndices.reserve(m_width * m_height);
+    m_sortedIndices.push_back((uint32_t)m_dist.index(startTile.x, startTile.y));
+    m_dist.set(startTile.x, startTile.y, 0);
 
-    for (size_t fringeIndex=0; fringeIndex<fringe.size(); ++fringeIndex)
+    if (metric == DistanceMetric::Octile)
     {
-        auto & tile = fringe[fringeIndex];
+        computeOctile(map);
+    }
+    else
+    {
+        computeFourConnected(map);
+    }
+
+    m_sortedIndices.shrink_to_fit();
+}
+
+// Uses BFS, since the map is quite large and DFS may cause a stack overflow
+void DistanceMap::computeFourConnected(const MapTools & map)
+{
+    // the tiles are visited in order of distance, so the BFS fringe doubles as the sorted tile list
+    for (size_t fringeIndex=0; fringeIndex<m_sortedIndices.size(); ++fringeIndex)
+    {
+        CCTilePosition tile = getSortedTile(fringeIndex);
+        uint16_t nextDist = (uint16_t)std::min(m_dist.get(tile.x, tile.y) + 1, Unreachable - 1);
 
         // check every possible child of this tile
         for (size_t a=0; a<LegalActions; ++a)
         {
-            CCTilePosition nextTile(tile.x + actionX[a], tile.y + actionY[a]);
+            int nextX = tile.x + actionX[a];
+            int nextY = tile.y + actionY[a];
 
             // if the new tile is inside the map bounds, is walkable, and has not been visited yet, set the distance of its parent + 1
-            if (m_bot.Map().isWalkable(nextTile) && getDistance(nextTile) == -1)
+            if (map.isWalkable(nextX, nextY) && m_dist.get(nextX, nextY) == Unreachable)
+            {
+                m_dist.set(nextX, nextY, nextDist);
+                m_sortedIndices.push_back((uint32_t)m_dist.index(nextX, nextY));
+            }
+        }
+    }
+}
+
+// Dijkstra with a bucket queue: every step costs 5 or 7, so the tentative distances
+// only ever span 8 consecutive values and a ring of 8 buckets replaces the heap.
+// A tile is added to the sorted list when its bucket is processed, at which point
+// its distance is final.
+void DistanceMap::computeOctile(const MapTools & map)
+{
+    const int numBuckets = OctileDiagonalCost + 1;
+    std::vector<uint32_t> buckets[numBuckets];
+    size_t pending = 0;
+
+    // the start tile goes through the buckets like every other tile
+    buckets[0].push_back(m_sortedIndices.front());
+    m_sortedIndices.clear();
+    pending++;
+
+    for (int dist = 0; pending > 0; ++dist)
+    {
+        std::vector<uint32_t> & bucket = buckets[dist % numBuckets];
+
+        // steps cost at least 5, so nothing is added to this bucket while we process it
+        for (size_t i(0); i < bucket.size(); ++i)
+        {
+            uint32_t index = bucket[i];
+            int x = index % m_width;
+            int y = index / m_width;
+
+            // skip tiles that were reached more cheaply after being put in this bucket
+            if (m_dist.get(x, y) != dist)
             {
-                m_dist[(int)nextTile.x][(int)nextTile.y] = m_dist[(int)tile.x][(int)tile.y] + 1;
-                fringe.push_back(nextTile);
-                m_sortedTiles.push_back(nextTile);
+                continue;
+            }
+
+            m_sortedIndices.push_back(index);
+
+            for (size_t a=0; a<OctileActions; ++a)
+            {
+                int nextX = x + octileX[a];
+                int nextY = y + octileY[a];
+
+                if (!map.isWalkable(nextX, nextY))
+                {
+                    continue;
+                }
+
+                bool diagonal = octileX[a] != 0 && octileY[a] != 0;
+
+                // a diagonal step may not cut the corner of a blocked tile
+                if (diagonal && (!map.isWalkable(x + octileX[a], y) || !map.isWalkable(x, y + octileY[a])))
+                {
+                    continue;
+                }
+
+                int nextDist = dist + (diagonal ? OctileDiagonalCost : OctileStraightCost);
+                if (nextDist >= Unreachable || nextDist >= m_dist.get(nextX, nextY))
+                {
+                    continue;
+                }
+
+                m_dist.set(nextX, nextY, (uint16_t)nextDist);
+                buckets[nextDist % numBuckets].push_back((uint32_t)m_dist.index(nextX, nextY));
+                pending++;
             }
         }
+
+        pending -= bucket.size();
+        bucket.clear();
     }
 }
 
 void DistanceMap::draw(IDABot & bot) const
 {
-    const int tilesToDraw = 200;
+    const size_t tilesToDraw = std::min((size_t)200, getNumSortedTiles());
     for (size_t i(0); i < tilesToDraw; ++i)
     {
-        auto & tile = m_sortedTiles[i];
+        CCTilePosition tile = getSortedTile(i);
         int dist = getDistance(tile);
 
         CCPosition textPos(tile.x + Util::TileToPosition(0.5), tile.y + Util::TileToPosition(0.5));
@@ -93,4 +301,13 @@ void DistanceMap::draw(IDABot & bot) const
 const CCTilePosition & DistanceMap::getStartTile() const
 {
     return m_startTile;
+}
+
+size_t DistanceMap::getMemoryUsage() const
+{
+    auto tiles = std::atomic_load(&m_sortedTiles);
+    return sizeof(DistanceMap)
+        + m_dist.size() * sizeof(uint16_t)
+        + m_sortedIndices.capacity() * sizeof(uint32_t)
+        + (tiles ? tiles->capacity() * sizeof(CCTilePosition) : 0);
 }
\ No newline at end of file
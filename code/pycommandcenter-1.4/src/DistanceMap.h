@@ -1,34 +1,77 @@
 #pragma once
 
 #include "Common.h"
+#include "TileGrid.h"
 #include <map>
+#include <memory>
 
 class IDABot;
+class MapTools;
 
+// how a DistanceMap moves between tiles
+enum class DistanceMetric
+{
+    FourConnected,  // horizontal and vertical steps of length 1, like a BFS
+    Octile          // diagonal steps as well, a diagonal may not cut past a blocked tile
+};
 
 class DistanceMap 
 {
+    // restores maps saved by earlier games without computing them again
+    friend class MapCache;
+
     int m_width;
     int m_height;
     CCTilePosition m_startTile;
+    DistanceMetric m_metric;
+
+    // grid storing distances from the start tile, Unreachable for tiles that can't be reached
+    TileGrid<uint16_t> m_dist;
+
+    // index (y * width + x) of every reachable tile, sorted by distance from the start tile
+    std::vector<uint32_t> m_sortedIndices;
 
-    // 2D matrix storing distances from the start tile
-    std::vector<std::vector<int>> m_dist;
+    // the sorted tiles as positions, only built the first time someone asks for them
+    mutable std::shared_ptr<const std::vector<CCTilePosition>> m_sortedTiles;
 
-    std::vector<CCTilePosition> m_sortedTiles;
+    void computeFourConnected(const MapTools & map);
+    void computeOctile(const MapTools & map);
     
 public:
+
+    static const uint16_t Unreachable = 0xFFFF;
+
+    // octile maps store distances in fifths of a tile, a diagonal step costs 7/5 ~ sqrt(2)
+    static const int OctileStraightCost = 5;
+    static const int OctileDiagonalCost = 7;
     
     DistanceMap();
-    void computeDistanceMap(IDABot & m_bot, const CCTilePosition & startTile);
+    void computeDistanceMap(IDABot & m_bot, const CCTilePosition & startTile, DistanceMetric metric = DistanceMetric::FourConnected);
+    // only reads the walkable tiles of the map, so several maps can be computed at once on different threads
+    void computeDistanceMap(const MapTools & map, const CCTilePosition & startTile, DistanceMetric metric = DistanceMetric::FourConnected);
 
     int getDistance(int tileX, int tileY) const;
     int getDistance(const CCTilePosition & pos) const;
     int getDistance(const CCPosition & pos) const;
+    // like getDistance, but walkable terrain under a building is reached by stepping onto it from its walkable
+    // neighbours, the same way the map leaves an unwalkable start tile, so a unit standing on a building still has a distance
+    int getDistanceOnto(const MapTools & map, const CCTilePosition & pos) const;
+    // the raw distance of the cheapest step onto the tile from one of its neighbours, Unreachable if there is none
+    uint16_t getStepDistance(const MapTools & map, int tileX, int tileY) const;
+    DistanceMetric getMetric() const;
+    // the raw distances, Unreachable for tiles that can't be reached and in fifths of a tile for octile maps
+    const TileGrid<uint16_t> & getDistanceGrid() const;
 
     // given a position, get the position we should move to to minimize distance
     const std::vector<CCTilePosition> & getSortedTiles() const;
     const CCTilePosition & getStartTile() const;
 
+    // access to the sorted tiles one at a time, without building the full list
+    size_t getNumSortedTiles() const;
+    CCTilePosition getSortedTile(size_t i) const;
+
+    // approximate number of bytes this map keeps allocated
+    size_t getMemoryUsage() const;
+
     void draw(IDABot & bot) const;
-};
\ No newline at end of file
+};
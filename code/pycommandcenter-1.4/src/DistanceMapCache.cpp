@@ -0,0 +1,159 @@
+#include "DistanceMapCache.h"
+
+DistanceMapCache::DistanceMapCache(size_t budget)
+{
+    m_stats.budget = budget;
+}
+
+std::shared_ptr<const DistanceMap> DistanceMapCache::find(const CCTilePosition & tile, DistanceMetric metric)
+{
+    std::shared_ptr<const DistanceMap> map = peek(tile, metric);
+    if (!map)
+    {
+        m_stats.misses++;
+    }
+
+    return map;
+}
+
+std::shared_ptr<const DistanceMap> DistanceMapCache::peek(const CCTilePosition & tile, DistanceMetric metric)
+{
+    auto it = m_index.find(Key(tile.x, tile.y, metric));
+    if (it == m_index.end() || !it->second->map)
+    {
+        return nullptr;
+    }
+
+    // move the entry to the front, since it is now the most recently used
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    m_stats.hits++;
+
+    return it->second->map;
+}
+
+void DistanceMapCache::insert(const CCTilePosition & tile, const std::shared_ptr<const DistanceMap> & map, bool pinned)
+{
+    Key key(tile.x, tile.y, map->getMetric());
+
+    auto it = m_index.find(key);
+    if (it != m_index.end())
+    {
+        // a map computed again after being invalidated stays pinned
+        pinned = pinned || it->second->pinned;
+
+        m_stats.bytes -= it->second->bytes;
+        m_stats.pinned -= it->second->pinned ? 1 : 0;
+        m_entries.erase(it->second);
+        m_index.erase(it);
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.map = map;
+    entry.bytes = map->getMemoryUsage();
+    entry.pinned = pinned;
+
+    m_entries.push_front(std::move(entry));
+    m_index[key] = m_entries.begin();
+
+    m_stats.bytes += m_entries.front().bytes;
+    m_stats.pinned += pinned ? 1 : 0;
+    m_stats.entries = m_entries.size();
+
+    // never evict the map that was just added
+    evict(&m_entries.front());
+}
+
+void DistanceMapCache::setPinned(const CCTilePosition & tile, DistanceMetric metric, bool pinned)
+{
+    auto it = m_index.find(Key(tile.x, tile.y, metric));
+    if (it == m_index.end() || it->second->pinned == pinned)
+    {
+        return;
+    }
+
+    it->second->pinned = pinned;
+    if (pinned)
+    {
+        m_stats.pinned++;
+    }
+    else
+    {
+        m_stats.pinned--;
+        evict(nullptr);
+    }
+}
+
+size_t DistanceMapCache::invalidate(const std::function<bool(const DistanceMap &)> & affected)
+{
+    size_t dropped = 0;
+
+    for (auto it = m_entries.begin(); it != m_entries.end(); )
+    {
+        if (!it->map || !affected(*it->map))
+        {
+            ++it;
+            continue;
+        }
+
+        dropped++;
+        m_stats.bytes -= it->bytes;
+        it->map.reset();
+        it->bytes = 0;
+
+        if (it->pinned)
+        {
+            ++it;
+        }
+        else
+        {
+            m_index.erase(it->key);
+            it = m_entries.erase(it);
+        }
+    }
+
+    m_stats.invalidations += dropped;
+    m_stats.entries = m_entries.size();
+    return dropped;
+}
+
+void DistanceMapCache::setBudget(size_t bytes)
+{
+    m_stats.budget = bytes;
+    evict(nullptr);
+}
+
+void DistanceMapCache::clear()
+{
+    m_entries.clear();
+    m_index.clear();
+    m_stats.entries = 0;
+    m_stats.pinned = 0;
+    m_stats.bytes = 0;
+}
+
+const DistanceMapCacheStats & DistanceMapCache::getStats() const
+{
+    return m_stats;
+}
+
+// drops the least recently used unpinned maps until we are within budget
+void DistanceMapCache::evict(const Entry * keep)
+{
+    auto it = m_entries.end();
+    while (m_stats.bytes > m_stats.budget && it != m_entries.begin())
+    {
+        --it;
+        if (it->pinned || &(*it) == keep)
+        {
+            continue;
+        }
+
+        m_stats.bytes -= it->bytes;
+        m_stats.evictions++;
+        m_index.erase(it->key);
+        it = m_entries.erase(it);
+    }
+
+    m_stats.entries = m_entries.size();
+}
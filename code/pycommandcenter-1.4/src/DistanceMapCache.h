@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Common.h"
+#include "DistanceMap.h"
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <tuple>
+
+struct DistanceMapCacheStats
+{
+    size_t hits         = 0;    // lookups answered from the cache
+    size_t misses       = 0;    // lookups that had to compute a new map
+    size_t evictions    = 0;    // maps dropped to stay within the budget
+    size_t invalidations = 0;   // maps dropped because the walkable tiles they were computed from changed
+    size_t entries      = 0;    // maps currently held
+    size_t pinned       = 0;    // maps currently held that will never be evicted
+    size_t bytes        = 0;    // approximate memory held by all maps
+    size_t budget       = 0;    // the memory the cache tries to stay within
+};
+
+// Holds computed DistanceMaps keyed by their start tile and metric. When the maps use more
+// memory than the budget, the least recently used ones are evicted. Pinned maps
+// (the ones belonging to base locations) are never evicted. The maps are shared
+// and immutable, so an evicted map stays alive for as long as someone holds it.
+// An invalidated pinned map keeps its entry without a map, so it is computed
+// again and stays pinned the next time it is asked for.
+class DistanceMapCache
+{
+    typedef std::tuple<int, int, DistanceMetric> Key;
+
+    struct Entry
+    {
+        Key             key;
+        std::shared_ptr<const DistanceMap> map;     // nullptr for an invalidated pinned map
+        size_t          bytes;
+        bool            pinned;
+    };
+
+    // most recently used entry first
+    std::list<Entry>                            m_entries;
+    std::map<Key, std::list<Entry>::iterator>   m_index;
+    DistanceMapCacheStats                       m_stats;
+
+    void evict(const Entry * keep);
+
+public:
+
+    static const size_t DefaultBudget = 32 * 1024 * 1024;
+
+    DistanceMapCache(size_t budget = DefaultBudget);
+
+    // returns the cached map for the tile, or nullptr if there is none
+    std::shared_ptr<const DistanceMap> find(const CCTilePosition & tile, DistanceMetric metric = DistanceMetric::FourConnected);
+
+    // like find, but a missing map is not counted as a miss since the caller won't compute one
+    std::shared_ptr<const DistanceMap> peek(const CCTilePosition & tile, DistanceMetric metric = DistanceMetric::FourConnected);
+
+    // stores a freshly computed map under its start tile and metric, evicting older ones if needed
+    void insert(const CCTilePosition & tile, const std::shared_ptr<const DistanceMap> & map, bool pinned = false);
+
+    void setPinned(const CCTilePosition & tile, DistanceMetric metric, bool pinned);
+
+    // drops every map for which affected returns true, returns how many were dropped
+    size_t invalidate(const std::function<bool(const DistanceMap &)> & affected);
+
+    void setBudget(size_t bytes);
+    void clear();
+
+    const DistanceMapCacheStats & getStats() const;
+};
@@ -0,0 +1,493 @@
+#include "HierarchicalPathFinder.h"
+#include "MapTools.h"
+
+#include <algorithm>
+
+const size_t LegalActions = 4;
+const int actionX[LegalActions] = {1, -1, 0, 0};
+const int actionY[LegalActions] = {0, 0, 1, -1};
+
+// border openings narrower than this get a single entrance in the middle, wider ones get one at each end
+const int MaxSingleEntranceWidth = 6;
+
+const int HierarchicalPathFinder::DefaultClusterSize;
+
+HierarchicalPathFinder::HierarchicalPathFinder()
+    : m_width(0)
+    , m_height(0)
+    , m_clusterSize(DefaultClusterSize)
+    , m_clustersX(0)
+    , m_clustersY(0)
+    , m_generation(0)
+{
+
+}
+
+void HierarchicalPathFinder::clear()
+{
+    m_width = 0;
+    m_height = 0;
+    m_clustersX = 0;
+    m_clustersY = 0;
+    m_nodeTiles.clear();
+    m_edges.clear();
+    m_clusterNodes.clear();
+    m_nodeAt.reset(0, 0);
+}
+
+void HierarchicalPathFinder::build(const MapTools & map, int clusterSize)
+{
+    BOT_ASSERT(clusterSize > 0, "Cluster size must be positive");
+
+    clear();
+
+    m_width = map.width();
+    m_height = map.height();
+    m_clusterSize = clusterSize;
+    m_clustersX = (m_width + clusterSize - 1) / clusterSize;
+    m_clustersY = (m_height + clusterSize - 1) / clusterSize;
+    m_clusterNodes.resize((size_t)m_clustersX * m_clustersY);
+    m_nodeAt.reset(m_width, m_height, -1);
+
+    m_localDist.assign((size_t)clusterSize * clusterSize, -1);
+    m_localParent.assign((size_t)clusterSize * clusterSize, -1);
+    m_localFringe.reserve((size_t)clusterSize * clusterSize);
+
+    placeEntrances(map);
+
+    for (size_t cluster=0; cluster<m_clusterNodes.size(); ++cluster)
+    {
+        connectCluster(map, (int)cluster);
+    }
+
+    resizeSearchBuffers();
+}
+
+void HierarchicalPathFinder::update(const MapTools & map, const std::vector<CCTilePosition> & changedTiles)
+{
+    if (m_nodeAt.empty() || changedTiles.empty())
+    {
+        return;
+    }
+
+    std::vector<bool> changed(m_clusterNodes.size(), false);
+    for (const CCTilePosition & tile : changedTiles)
+    {
+        changed[getCluster(tile.x, tile.y)] = true;
+    }
+
+    // keep the old graph, the edges inside clusters that didn't change can be copied from it
+    std::vector<CCTilePosition> oldTiles;
+    std::vector<std::vector<Edge>> oldEdges;
+    std::vector<std::vector<int>> oldClusterNodes(m_clusterNodes.size());
+    oldTiles.swap(m_nodeTiles);
+    oldEdges.swap(m_edges);
+    oldClusterNodes.swap(m_clusterNodes);
+    m_nodeAt.fill(-1);
+
+    // entrances only cost a walk along the cluster borders, so they are all placed again
+    placeEntrances(map);
+
+    for (size_t cluster=0; cluster<m_clusterNodes.size(); ++cluster)
+    {
+        const std::vector<int> & oldNodes = oldClusterNodes[cluster];
+        bool sameNodes = oldNodes.size() == m_clusterNodes[cluster].size();
+
+        for (size_t i=0; sameNodes && i<oldNodes.size(); ++i)
+        {
+            const CCTilePosition & tile = oldTiles[oldNodes[i]];
+            sameNodes = m_nodeAt.get(tile.x, tile.y) >= 0;
+        }
+
+        if (changed[cluster] || !sameNodes)
+        {
+            connectCluster(map, (int)cluster);
+            continue;
+        }
+
+        // same tiles and same entrances, so the old distances between the entrances still hold
+        for (int oldNode : oldNodes)
+        {
+            int node = m_nodeAt.get(oldTiles[oldNode].x, oldTiles[oldNode].y);
+
+            for (const Edge & edge : oldEdges[oldNode])
+            {
+                const CCTilePosition & to = oldTiles[edge.to];
+                if (getCluster(to.x, to.y) == (int)cluster)
+                {
+                    m_edges[node].push_back({ m_nodeAt.get(to.x, to.y), edge.cost });
+                }
+            }
+        }
+    }
+
+    resizeSearchBuffers();
+}
+
+// places entrances along the left border of every cluster except the first column,
+// and along the bottom border of every cluster except the first row
+void HierarchicalPathFinder::placeEntrances(const MapTools & map)
+{
+    for (int cy=0; cy<m_clustersY; ++cy)
+    {
+        for (int cx=1; cx<m_clustersX; ++cx)
+        {
+            int y = cy * m_clusterSize;
+            addEntrances(map, cx * m_clusterSize, y, 0, 1, std::min(m_clusterSize, m_height - y));
+        }
+    }
+
+    for (int cy=1; cy<m_clustersY; ++cy)
+    {
+        for (int cx=0; cx<m_clustersX; ++cx)
+        {
+            int x = cx * m_clusterSize;
+            addEntrances(map, x, cy * m_clusterSize, 1, 0, std::min(m_clusterSize, m_width - x));
+        }
+    }
+}
+
+// connects the nodes inside the cluster by their walk distance within the cluster
+void HierarchicalPathFinder::connectCluster(const MapTools & map, int cluster)
+{
+    const std::vector<int> & nodes = m_clusterNodes[cluster];
+
+    for (int node : nodes)
+    {
+        floodCluster(map, cluster, m_nodeTiles[node]);
+
+        for (int other : nodes)
+        {
+            int dist = getLocalDist(cluster, m_nodeTiles[other]);
+            if (other != node && dist > 0)
+            {
+                m_edges[node].push_back({ other, dist });
+            }
+        }
+    }
+}
+
+void HierarchicalPathFinder::resizeSearchBuffers()
+{
+    size_t numNodes = m_nodeTiles.size();
+    m_visited.assign(numNodes + 2, 0);
+    m_cost.assign(numNodes + 2, 0);
+    m_parent.assign(numNodes + 2, 0);
+    m_goalDist.assign(numNodes, -1);
+    m_generation = 0;
+}
+
+int HierarchicalPathFinder::getCluster(int x, int y) const
+{
+    return (y / m_clusterSize) * m_clustersX + (x / m_clusterSize);
+}
+
+int HierarchicalPathFinder::getOrAddNode(const CCTilePosition & tile)
+{
+    int node = m_nodeAt.get(tile.x, tile.y);
+    if (node >= 0)
+    {
+        return node;
+    }
+
+    node = (int)m_nodeTiles.size();
+    m_nodeTiles.push_back(tile);
+    m_edges.emplace_back();
+    m_clusterNodes[getCluster(tile.x, tile.y)].push_back(node);
+    m_nodeAt.set(tile.x, tile.y, node);
+    return node;
+}
+
+// walks the border tiles (x, y) + i * (dx, dy) of a cluster, whose neighbours across the
+// border are one step back along (dy, dx), and places entrances on every walkable opening
+void HierarchicalPathFinder::addEntrances(const MapTools & map, int x, int y, int dx, int dy, int length)
+{
+    int openStart = -1;
+
+    for (int i=0; i<=length; ++i)
+    {
+        CCTilePosition inside(x + i*dx, y + i*dy);
+        CCTilePosition outside(inside.x - dy, inside.y - dx);
+        bool open = i < length && map.isWalkable(inside) && map.isWalkable(outside);
+
+        if (open && openStart < 0)
+        {
+            openStart = i;
+        }
+        else if (!open && openStart >= 0)
+        {
+            int openLength = i - openStart;
+            if (openLength < MaxSingleEntranceWidth)
+            {
+                int mid = openStart + openLength / 2;
+                addEntrance(CCTilePosition(x + mid*dx - dy, y + mid*dy - dx), CCTilePosition(x + mid*dx, y + mid*dy));
+            }
+            else
+            {
+                int last = i - 1;
+                addEntrance(CCTilePosition(x + openStart*dx - dy, y + openStart*dy - dx), CCTilePosition(x + openStart*dx, y + openStart*dy));
+                addEntrance(CCTilePosition(x + last*dx - dy, y + last*dy - dx), CCTilePosition(x + last*dx, y + last*dy));
+            }
+
+            openStart = -1;
+        }
+    }
+}
+
+void HierarchicalPathFinder::addEntrance(const CCTilePosition & a, const CCTilePosition & b)
+{
+    int nodeA = getOrAddNode(a);
+    int nodeB = getOrAddNode(b);
+    m_edges[nodeA].push_back({ nodeB, 1 });
+    m_edges[nodeB].push_back({ nodeA, 1 });
+}
+
+// BFS from start that never leaves the given cluster, the start tile itself does not have to be walkable
+void HierarchicalPathFinder::floodCluster(const MapTools & map, int cluster, const CCTilePosition & start)
+{
+    int x0 = (cluster % m_clustersX) * m_clusterSize;
+    int y0 = (cluster / m_clustersX) * m_clusterSize;
+    int x1 = std::min(x0 + m_clusterSize, m_width);
+    int y1 = std::min(y0 + m_clusterSize, m_height);
+
+    std::fill(m_localDist.begin(), m_localDist.end(), -1);
+    m_localFringe.clear();
+
+    int startIndex = (start.y - y0) * m_clusterSize + (start.x - x0);
+    m_localDist[startIndex] = 0;
+    m_localParent[startIndex] = startIndex;
+    m_localFringe.push_back(startIndex);
+
+    for (size_t fringeIndex=0; fringeIndex<m_localFringe.size(); ++fringeIndex)
+    {
+        int index = m_localFringe[fringeIndex];
+        int x = x0 + index % m_clusterSize;
+        int y = y0 + index / m_clusterSize;
+
+        for (size_t a=0; a<LegalActions; ++a)
+        {
+            int nextX = x + actionX[a];
+            int nextY = y + actionY[a];
+
+            if (nextX < x0 || nextY < y0 || nextX >= x1 || nextY >= y1 || !map.isWalkable(nextX, nextY))
+            {
+                continue;
+            }
+
+            int nextIndex = (nextY - y0) * m_clusterSize + (nextX - x0);
+            if (m_localDist[nextIndex] < 0)
+            {
+                m_localDist[nextIndex] = m_localDist[index] + 1;
+                m_localParent[nextIndex] = index;
+                m_localFringe.push_back(nextIndex);
+            }
+        }
+    }
+}
+
+// distance to a tile of the cluster that was flooded last, -1 if it wasn't reached
+int HierarchicalPathFinder::getLocalDist(int cluster, const CCTilePosition & tile) const
+{
+    int x0 = (cluster % m_clustersX) * m_clusterSize;
+    int y0 = (cluster / m_clustersX) * m_clusterSize;
+    return m_localDist[(tile.y - y0) * m_clusterSize + (tile.x - x0)];
+}
+
+// appends the tiles after 'from' up to and including 'to', which are either neighbours across
+// a cluster border or tiles in the same cluster
+void HierarchicalPathFinder::appendLocalPath(const MapTools & map, const CCTilePosition & from, const CCTilePosition & to, std::vector<CCTilePosition> & path)
+{
+    int cluster = getCluster(to.x, to.y);
+    if (getCluster(from.x, from.y) != cluster)
+    {
+        path.push_back(to);
+        return;
+    }
+
+    floodCluster(map, cluster, from);
+
+    int x0 = (cluster % m_clustersX) * m_clusterSize;
+    int y0 = (cluster / m_clustersX) * m_clusterSize;
+    int fromIndex = (from.y - y0) * m_clusterSize + (from.x - x0);
+    size_t first = path.size();
+
+    for (int index = (to.y - y0) * m_clusterSize + (to.x - x0); index != fromIndex; index = m_localParent[index])
+    {
+        path.push_back(CCTilePosition(x0 + index % m_clusterSize, y0 + index / m_clusterSize));
+    }
+
+    std::reverse(path.begin() + first, path.end());
+}
+
+int HierarchicalPathFinder::search(const MapTools & map, const CCTilePosition & start, const CCTilePosition & goal, std::vector<CCTilePosition> * path)
+{
+    if (path != nullptr)
+    {
+        path->clear();
+    }
+
+    if (m_nodeAt.empty() || !map.isValidTile(start) || !map.isValidTile(goal))
+    {
+        return -1;
+    }
+
+    if (start == goal)
+    {
+        if (path != nullptr)
+        {
+            path->push_back(goal);
+        }
+        return 0;
+    }
+
+    // the goal has to be walkable, and if both ends are walkable they have to share a sector
+    if (!map.isWalkable(goal) || (map.isWalkable(start) && !map.isConnected(start, goal)))
+    {
+        return -1;
+    }
+
+    int startCluster = getCluster(start.x, start.y);
+    int goalCluster = getCluster(goal.x, goal.y);
+    const std::vector<int> & startNodes = m_clusterNodes[startCluster];
+    const std::vector<int> & goalNodes = m_clusterNodes[goalCluster];
+
+    // moves are symmetric, so the distances from the goal to the nodes of its cluster are also the distances to the goal
+    floodCluster(map, goalCluster, goal);
+    for (int node : goalNodes)
+    {
+        m_goalDist[node] = getLocalDist(goalCluster, m_nodeTiles[node]);
+    }
+
+    floodCluster(map, startCluster, start);
+    int direct = startCluster == goalCluster ? getLocalDist(startCluster, goal) : -1;
+
+    if (++m_generation == 0)
+    {
+        std::fill(m_visited.begin(), m_visited.end(), 0);
+        m_generation = 1;
+    }
+    m_open.clear();
+
+    int numNodes = (int)m_nodeTiles.size();
+    int startIndex = numNodes;
+    int goalIndex = numNodes + 1;
+
+    // manhattan distance never overestimates on a 4-connected grid
+    auto relax = [&](int index, int cost, int parent)
+    {
+        if (m_visited[index] == m_generation && m_cost[index] <= cost)
+        {
+            return;
+        }
+
+        m_visited[index] = m_generation;
+        m_cost[index] = cost;
+        m_parent[index] = parent;
+
+        int h = index == goalIndex ? 0 : std::abs(goal.x - m_nodeTiles[index].x) + std::abs(goal.y - m_nodeTiles[index].y);
+        m_open.push_back({ cost + h, cost, index });
+        std::push_heap(m_open.begin(), m_open.end());
+    };
+
+    m_visited[startIndex] = m_generation;
+    m_cost[startIndex] = 0;
+    m_parent[startIndex] = startIndex;
+
+    // the start connects to the nodes of its cluster, and straight to the goal if it shares the cluster
+    if (direct >= 0)
+    {
+        relax(goalIndex, direct, startIndex);
+    }
+
+    for (int node : startNodes)
+    {
+        int dist = getLocalDist(startCluster, m_nodeTiles[node]);
+        if (dist >= 0)
+        {
+            relax(node, dist, startIndex);
+        }
+    }
+
+    while (!m_open.empty())
+    {
+        std::pop_heap(m_open.begin(), m_open.end());
+        Node node = m_open.back();
+        m_open.pop_back();
+
+        // skip stale heap entries for nodes we have since reached more cheaply
+        if (node.g > m_cost[node.index])
+        {
+            continue;
+        }
+
+        if (node.index == goalIndex)
+        {
+            break;
+        }
+
+        for (const Edge & edge : m_edges[node.index])
+        {
+            relax(edge.to, node.g + edge.cost, node.index);
+        }
+
+        // only the nodes of the goal cluster have a distance to the goal
+        if (m_goalDist[node.index] >= 0)
+        {
+            relax(goalIndex, node.g + m_goalDist[node.index], node.index);
+        }
+    }
+
+    for (int node : goalNodes)
+    {
+        m_goalDist[node] = -1;
+    }
+
+    if (m_visited[goalIndex] != m_generation)
+    {
+        return -1;
+    }
+
+    if (path != nullptr)
+    {
+        // the nodes the path goes through, from the start to the goal
+        std::vector<CCTilePosition> waypoints;
+        for (int index = goalIndex; index != startIndex; index = m_parent[index])
+        {
+            waypoints.push_back(index == goalIndex ? goal : m_nodeTiles[index]);
+        }
+        waypoints.push_back(start);
+        std::reverse(waypoints.begin(), waypoints.end());
+
+        path->push_back(start);
+        for (size_t i=1; i<waypoints.size(); ++i)
+        {
+            appendLocalPath(map, waypoints[i-1], waypoints[i], *path);
+        }
+
+        // same order as PathFinder, from the goal back to the start
+        std::reverse(path->begin(), path->end());
+    }
+
+    return m_cost[goalIndex];
+}
+
+size_t HierarchicalPathFinder::getNumNodes() const
+{
+    return m_nodeTiles.size();
+}
+
+size_t HierarchicalPathFinder::getNumEdges() const
+{
+    size_t edges = 0;
+    for (const auto & nodeEdges : m_edges)
+    {
+        edges += nodeEdges.size();
+    }
+
+    return edges;
+}
+
+int HierarchicalPathFinder::getClusterSize() const
+{
+    return m_clusterSize;
+}
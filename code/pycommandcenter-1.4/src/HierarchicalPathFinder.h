@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Common.h"
+#include "TileGrid.h"
+#include <vector>
+
+class MapTools;
+
+// A HPA* style abstraction of the walkable grid, used to answer ground distance
+// queries much faster than a tile level search.
+//
+// The map is cut into square clusters. Wherever two neighbouring clusters share
+// a run of walkable tiles along their border, one or two entrances are placed
+// on it, each made of a node on either side. The walk distances between the
+// nodes inside each cluster are computed once when the graph is built, so a
+// query only has to search the two clusters holding its end points and then
+// the small graph of nodes in between.
+//
+// Moves are four connected like DistanceMap. Since paths have to go through
+// the entrances the distances are an upper bound of the true distance, usually
+// within a few tiles of it.
+class HierarchicalPathFinder
+{
+    struct Edge
+    {
+        int     to;
+        int     cost;
+    };
+
+    struct Node
+    {
+        int     f;
+        int     g;
+        int     index;
+
+        // the heap is a max-heap, so the node with the lowest f (and highest g on ties) should compare greatest
+        bool operator < (const Node & rhs) const
+        {
+            return f > rhs.f || (f == rhs.f && g < rhs.g);
+        }
+    };
+
+    int                             m_width;
+    int                             m_height;
+    int                             m_clusterSize;
+    int                             m_clustersX;
+    int                             m_clustersY;
+
+    std::vector<CCTilePosition>     m_nodeTiles;        // the tile of every entrance node
+    std::vector<std::vector<Edge>>  m_edges;            // edges leaving every node, to nodes in the same or a neighbouring cluster
+    std::vector<std::vector<int>>   m_clusterNodes;     // the nodes inside every cluster
+    TileGrid<int>                   m_nodeAt;           // node on a tile, or -1
+
+    // scratch buffers for flooding one cluster, indexed by the tile position inside the cluster
+    std::vector<int>                m_localDist;
+    std::vector<int>                m_localParent;
+    std::vector<int>                m_localFringe;
+
+    // scratch buffers for the search over the nodes, the start and goal get the last two indices
+    uint32_t                        m_generation;
+    std::vector<uint32_t>           m_visited;
+    std::vector<int>                m_cost;
+    std::vector<int>                m_parent;
+    std::vector<int>                m_goalDist;
+    std::vector<Node>               m_open;
+
+    int     getCluster(int x, int y) const;
+    int     getOrAddNode(const CCTilePosition & tile);
+    void    placeEntrances(const MapTools & map);
+    void    connectCluster(const MapTools & map, int cluster);
+    void    resizeSearchBuffers();
+    void    addEntrances(const MapTools & map, int x, int y, int dx, int dy, int length);
+    void    addEntrance(const CCTilePosition & a, const CCTilePosition & b);
+    void    floodCluster(const MapTools & map, int cluster, const CCTilePosition & start);
+    int     getLocalDist(int cluster, const CCTilePosition & tile) const;
+    void    appendLocalPath(const MapTools & map, const CCTilePosition & from, const CCTilePosition & to, std::vector<CCTilePosition> & path);
+
+public:
+
+    static const int DefaultClusterSize = 16;
+
+    HierarchicalPathFinder();
+
+    // builds the graph from the walkable tiles of the map
+    void build(const MapTools & map, int clusterSize = DefaultClusterSize);
+
+    // brings the graph up to date after the walkability of the given tiles changed, only the
+    // clusters holding those tiles or whose entrances moved are searched again
+    void update(const MapTools & map, const std::vector<CCTilePosition> & changedTiles);
+    void clear();
+
+    // Returns the approximate ground distance from start to goal, or -1 if goal can't be reached.
+    // As in DistanceMap, the start tile does not have to be walkable but the goal does.
+    // If path is given, it is filled with the tiles from goal back to start.
+    int search(const MapTools & map, const CCTilePosition & start, const CCTilePosition & goal, std::vector<CCTilePosition> * path = nullptr);
+
+    size_t getNumNodes() const;
+    size_t getNumEdges() const;
+    int getClusterSize() const;
+};
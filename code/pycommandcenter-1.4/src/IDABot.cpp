@@ -8,6 +8,8 @@ IDABot::IDABot()
 	, m_unitInfo(*this)
 	, m_techTree(*this)
     , m_buildingPlacer(*this)
+    , m_unitUpdate(0)
+    , m_unitSnapshotDirty(true)
 {
 }
 
@@ -25,9 +27,13 @@ void IDABot::OnGameStart()
 	// -----------------------------------------------------------------
 	// Initialize all info, units, etc.
 	// -----------------------------------------------------------------
+	m_allUnits.clear();
+	m_unitSeen.clear();
+	m_unitSlots.clear();
 	setUnits();
 	m_techTree.onStart();
 	m_map.onStart();
+	m_unitSpatialIndex.build(m_allUnits, m_map.width(), m_map.height());
 	m_unitInfo.onStart();
 	m_bases.onStart();
     m_buildingPlacer.onStart();
@@ -70,12 +76,14 @@ void IDABot::OnStep()
 	// -----------------------------------------------------------------
 	setUnits();
 	m_map.onFrame();
+	m_unitSpatialIndex.build(m_allUnits, m_map.width(), m_map.height());
 	m_unitInfo.onFrame();
 	m_bases.onFrame();
 
 	// suppress warnings while we update the tiles occupied by units
 	bool old_suppress = m_techTree.getSuppressWarnings();
 	m_techTree.setSuppressWarnings(true);
+	m_map.updateBlockers(GetAllUnits());
 	m_buildingPlacer.updateReserved(GetAllUnits());
 	m_techTree.setSuppressWarnings(old_suppress);
 
@@ -88,12 +96,53 @@ void IDABot::OnStep()
 
 void IDABot::setUnits()
 {
-	m_allUnits.clear();
 	Control()->GetObservation();
-	for (auto & unit : Observation()->GetUnits())
+	const sc2::Units units = Observation()->GetUnits();
+
+	// a unit keeps its slot, and the Unit in it, for as long as its tag is listed, new units are added at the
+	// end and the slot of a unit that is gone is filled with the last unit, so only those entries change
+	m_unitUpdate++;
+	for (auto unit : units)
+	{
+		auto slot = m_unitSlots.find(unit->tag);
+		if (slot == m_unitSlots.end())
+		{
+			m_unitSlots.emplace(unit->tag, m_allUnits.size());
+			m_allUnits.push_back(Unit(unit, *this));
+			m_unitSeen.push_back(m_unitUpdate);
+			continue;
+		}
+
+		// the game keeps the same sc2::Unit for a tag, but a unit that morphs gets a new type
+		Unit & existing = m_allUnits[slot->second];
+		if (existing.getUnitPtr() != unit || existing.getType().getAPIUnitType() != unit->unit_type)
+		{
+			existing = Unit(unit, *this);
+		}
+		m_unitSeen[slot->second] = m_unitUpdate;
+	}
+
+	for (size_t i = 0; i < m_allUnits.size(); )
 	{
-		m_allUnits.push_back(Unit(unit, *this));
+		if (m_unitSeen[i] == m_unitUpdate)
+		{
+			++i;
+			continue;
+		}
+
+		// the last unit moves in here, and is checked in its turn since it may be gone as well
+		m_unitSlots.erase(m_allUnits[i].getID());
+		if (i + 1 < m_allUnits.size())
+		{
+			m_allUnits[i] = m_allUnits.back();
+			m_unitSeen[i] = m_unitSeen.back();
+			m_unitSlots[m_allUnits[i].getID()] = i;
+		}
+		m_allUnits.pop_back();
+		m_unitSeen.pop_back();
 	}
+
+	m_unitSnapshotDirty = true;
 }
 
 CCRace IDABot::GetPlayerRace(int player) const
@@ -158,6 +207,12 @@ int IDABot::GetGas() const
 
 Unit IDABot::GetUnit(const CCUnitID & tag) const
 {
+	auto slot = m_unitSlots.find(tag);
+	if (slot != m_unitSlots.end())
+	{
+		return m_allUnits[slot->second];
+	}
+
 	return Unit(Observation()->GetUnit(tag), *(IDABot *)this);
 }
 
@@ -171,6 +226,29 @@ const std::vector<Unit> & IDABot::GetMyUnits() const
 	return UnitInfo().getUnits(Players::Self);
 }
 
+std::shared_ptr<const UnitSnapshot> IDABot::GetUnitSnapshot() const
+{
+	if (m_unitSnapshot && !m_unitSnapshotDirty)
+	{
+		return m_unitSnapshot;
+	}
+
+	// arrays handed out for an earlier frame still point into the old snapshot, so it can only be refilled once they are gone
+	if (!m_unitSnapshot || m_unitSnapshot.use_count() > 1)
+	{
+		m_unitSnapshot = std::make_shared<UnitSnapshot>();
+	}
+
+	m_unitSnapshot->build(m_allUnits, GetCurrentFrame());
+	m_unitSnapshotDirty = false;
+	return m_unitSnapshot;
+}
+
+const UnitSpatialIndex & IDABot::GetUnitSpatialIndex() const
+{
+	return m_unitSpatialIndex;
+}
+
 const std::vector<Unit> IDABot::GetUnits(const UnitType & type, int player) const
 {
     std::vector<Unit> units;
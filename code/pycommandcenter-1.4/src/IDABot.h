@@ -2,6 +2,8 @@
 
 #include <deque>
 #include <limits>
+#include <memory>
+#include <unordered_map>
 
 #include "Common.h"
 
@@ -13,6 +15,8 @@
 #include "TechTreeImproved.h"
 #include "MetaType.h"
 #include "Unit.h"
+#include "UnitSnapshot.h"
+#include "UnitSpatialIndex.h"
 
 using sc2::UnitTypeID;
 using sc2::Point2D;
@@ -27,6 +31,15 @@ class IDABot : public sc2::Agent
     BuildingPlacer          m_buildingPlacer;
 
     std::vector<Unit>       m_allUnits;
+    std::vector<uint32_t>   m_unitSeen;     // the update every unit of m_allUnits was last listed in
+    std::unordered_map<CCUnitID, size_t> m_unitSlots;  // where every unit of m_allUnits is, by tag
+    uint32_t                m_unitUpdate;
+
+    // built from m_allUnits the first time it is asked for after the units were updated
+    mutable std::shared_ptr<UnitSnapshot> m_unitSnapshot;
+    mutable bool            m_unitSnapshotDirty;
+    // rebuilt from m_allUnits at the start of every step, so that a reference to it never goes stale
+    UnitSpatialIndex        m_unitSpatialIndex;
     std::vector<CCPosition> m_baseLocations;
 
     void setUnits();
@@ -60,6 +73,11 @@ public:
     Unit GetUnit(const CCUnitID & tag) const;
     const std::vector<Unit> & GetAllUnits() const;
 	const std::vector<Unit> & GetMyUnits() const;
+    // the values of GetAllUnits on this frame stored column by column, a snapshot that is no longer
+    // referenced by anyone else is reused for the next frame
+    std::shared_ptr<const UnitSnapshot> GetUnitSnapshot() const;
+    // a grid over the units of GetAllUnits for finding the units near a point, rebuilt at the start of every step
+    const UnitSpatialIndex & GetUnitSpatialIndex() const;
     const std::vector<Unit> GetUnits(const UnitType & type, int player = Players::Self) const;
     const std::vector<CCPosition> & GetStartLocations() const;
 
@@ -0,0 +1,280 @@
+#include "MapCache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+const uint64_t MapCache::Magic;
+const uint32_t MapCache::Version;
+
+// no real map has anywhere near this many bases, a larger count means the file is broken
+const uint32_t MaxCachedBases = 1024;
+
+namespace
+{
+    struct Header
+    {
+        uint64_t    magic;
+        uint32_t    version;
+        int32_t     width;
+        int32_t     height;
+        int32_t     numSectors;
+        uint64_t    hash;
+        uint32_t    nameLength;
+        uint32_t    numBases;
+    };
+
+    struct BaseHeader
+    {
+        int32_t     centerX;
+        int32_t     centerY;
+        int32_t     depotX;
+        int32_t     depotY;
+        int32_t     metric;
+        uint32_t    numSortedTiles;
+    };
+
+    // every block starts on a multiple of 8 bytes
+    size_t padding(size_t bytes)
+    {
+        return (8 - bytes % 8) % 8;
+    }
+
+    void writeBlock(std::ostream & out, const void * data, size_t bytes)
+    {
+        static const char zeros[8] = {};
+        out.write(static_cast<const char *>(data), bytes);
+        out.write(zeros, padding(bytes));
+    }
+
+    bool readBlock(std::istream & in, void * data, size_t bytes)
+    {
+        char skipped[8];
+        in.read(static_cast<char *>(data), bytes);
+        in.read(skipped, padding(bytes));
+        return (bool)in;
+    }
+
+    void writeBits(std::ostream & out, const TileGrid<bool> & grid)
+    {
+        writeBlock(out, grid.words(), grid.wordCount() * sizeof(uint64_t));
+    }
+
+    bool readBits(std::istream & in, TileGrid<bool> & grid, int width, int height)
+    {
+        grid.reset(width, height);
+        return readBlock(in, grid.words(), grid.wordCount() * sizeof(uint64_t));
+    }
+
+    template <class T>
+    void writeGrid(std::ostream & out, const TileGrid<T> & grid)
+    {
+        writeBlock(out, grid.data(), grid.size() * sizeof(T));
+    }
+
+    template <class T>
+    bool readGrid(std::istream & in, TileGrid<T> & grid, int width, int height)
+    {
+        grid.reset(width, height);
+        return readBlock(in, grid.data(), grid.size() * sizeof(T));
+    }
+}
+
+uint64_t MapCache::hashBytes(const void * data, size_t size, uint64_t hash)
+{
+    const unsigned char * bytes = static_cast<const unsigned char *>(data);
+    for (size_t i=0; i<size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+std::string MapCache::getPath(const std::string & directory, const std::string & mapName, uint64_t hash)
+{
+    // map names may contain spaces and characters that aren't allowed in file names
+    std::string name;
+    for (char c : mapName)
+    {
+        bool allowed = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_';
+        name += allowed ? c : '_';
+    }
+
+    char hashText[17];
+    snprintf(hashText, sizeof(hashText), "%016llx", (unsigned long long)hash);
+
+    std::string path = directory;
+    if (!path.empty() && path.back() != '/' && path.back() != '\\')
+    {
+        path += '/';
+    }
+
+    return path + name + "-" + hashText + ".mapcache";
+}
+
+bool MapCache::load(const std::string & path, const std::string & mapName, uint64_t hash, int width, int height, MapCacheData & data)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        return false;
+    }
+
+    Header header;
+    if (!readBlock(in, &header, sizeof(header))
+        || header.magic != Magic
+        || header.version != Version
+        || header.width != width
+        || header.height != height
+        || header.hash != hash
+        || header.nameLength != mapName.size()
+        || header.numBases > MaxCachedBases
+        || header.numSectors < 0)
+    {
+        return false;
+    }
+
+    data.mapName.resize(header.nameLength);
+    if (!readBlock(in, &data.mapName[0], header.nameLength) || data.mapName != mapName)
+    {
+        return false;
+    }
+
+    data.hash = header.hash;
+    data.numSectors = header.numSectors;
+
+    if (!readBits(in, data.walkable, width, height)
+        || !readBits(in, data.buildable, width, height)
+        || !readBits(in, data.depotBuildable, width, height)
+        || !readGrid(in, data.terrainHeight, width, height)
+        || !readGrid(in, data.sectorNumber, width, height))
+    {
+        return false;
+    }
+
+    // the sectors are used as indices later on, so a damaged file must not get past here
+    for (size_t i(0); i < data.sectorNumber.size(); ++i)
+    {
+        int sector = data.sectorNumber.data()[i];
+        if (sector < 0 || sector > data.numSectors)
+        {
+            return false;
+        }
+    }
+
+    data.bases.clear();
+    for (uint32_t b=0; b<header.numBases; ++b)
+    {
+        BaseHeader baseHeader;
+        if (!readBlock(in, &baseHeader, sizeof(baseHeader)) || baseHeader.numSortedTiles > (uint32_t)width * height)
+        {
+            return false;
+        }
+
+        // the metric decides how the distances are read back, so only the ones DistanceMap knows are accepted
+        if (baseHeader.metric != (int32_t)DistanceMetric::FourConnected && baseHeader.metric != (int32_t)DistanceMetric::Octile)
+        {
+            return false;
+        }
+
+        auto map = std::make_shared<DistanceMap>();
+        map->m_width = width;
+        map->m_height = height;
+        map->m_startTile = CCTilePosition(baseHeader.centerX, baseHeader.centerY);
+        map->m_metric = (DistanceMetric)baseHeader.metric;
+        map->m_sortedIndices.resize(baseHeader.numSortedTiles);
+
+        if (!readGrid(in, map->m_dist, width, height)
+            || !readBlock(in, map->m_sortedIndices.data(), map->m_sortedIndices.size() * sizeof(uint32_t)))
+        {
+            return false;
+        }
+
+        for (uint32_t index : map->m_sortedIndices)
+        {
+            if (index >= (uint32_t)width * height)
+            {
+                return false;
+            }
+        }
+
+        MapCacheBase base;
+        base.center = map->m_startTile;
+        base.depot = CCTilePosition(baseHeader.depotX, baseHeader.depotY);
+        base.distanceMap = map;
+        data.bases.push_back(base);
+    }
+
+    return true;
+}
+
+bool MapCache::save(const std::string & path, const MapCacheData & data)
+{
+    // write to a temporary file first, so a game reading the cache never sees half a file,
+    // with a random name since several games on the same map may finish their analysis at once
+    const std::string tempPath = path + "." + std::to_string(std::random_device()()) + ".tmp";
+
+    bool written = false;
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            return false;
+        }
+
+        Header header = {};
+        header.magic = Magic;
+        header.version = Version;
+        header.width = data.walkable.width();
+        header.height = data.walkable.height();
+        header.numSectors = data.numSectors;
+        header.hash = data.hash;
+        header.nameLength = (uint32_t)data.mapName.size();
+        header.numBases = (uint32_t)data.bases.size();
+
+        writeBlock(out, &header, sizeof(header));
+        writeBlock(out, data.mapName.data(), data.mapName.size());
+        writeBits(out, data.walkable);
+        writeBits(out, data.buildable);
+        writeBits(out, data.depotBuildable);
+        writeGrid(out, data.terrainHeight);
+        writeGrid(out, data.sectorNumber);
+
+        for (const MapCacheBase & base : data.bases)
+        {
+            const DistanceMap & map = *base.distanceMap;
+
+            BaseHeader baseHeader = {};
+            baseHeader.centerX = base.center.x;
+            baseHeader.centerY = base.center.y;
+            baseHeader.depotX = base.depot.x;
+            baseHeader.depotY = base.depot.y;
+            baseHeader.metric = (int32_t)map.m_metric;
+            baseHeader.numSortedTiles = (uint32_t)map.m_sortedIndices.size();
+
+            writeBlock(out, &baseHeader, sizeof(baseHeader));
+            writeGrid(out, map.m_dist);
+            writeBlock(out, map.m_sortedIndices.data(), map.m_sortedIndices.size() * sizeof(uint32_t));
+        }
+
+        written = (bool)out;
+    }
+
+    if (!written)
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    // rename doesn't replace an existing file everywhere, and an existing file is stale anyway
+    std::remove(path.c_str());
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Common.h"
+#include "DistanceMap.h"
+#include "TileGrid.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// what is remembered about a base location between games
+struct MapCacheBase
+{
+    CCTilePosition                      center;         // tile of the resource center, where the distance map starts
+    CCTilePosition                      depot;          // where the resource depot of the base goes
+    std::shared_ptr<const DistanceMap>  distanceMap;
+};
+
+// the part of the map analysis that only depends on the map itself
+struct MapCacheData
+{
+    std::string                 mapName;
+    uint64_t                    hash = 0;
+    TileGrid<bool>              walkable;
+    TileGrid<bool>              buildable;
+    TileGrid<bool>              depotBuildable;
+    TileGrid<float>             terrainHeight;
+    TileGrid<int>               sectorNumber;
+    int                         numSectors = 0;
+    std::vector<MapCacheBase>   bases;
+};
+
+// Saves the static map analysis to disk so games on a map that was seen before can skip it.
+//
+// The file is a header followed by the raw grids, every block padded to 8 bytes so the
+// file could just as well be mapped into memory. A file is only used if its version,
+// map name, size and hash all match, anything else is treated as a missing file and
+// gets overwritten after the analysis has been done again.
+class MapCache
+{
+    static const uint64_t Magic = 0x48434150414d4350ull;   // "PCMAPACH"
+
+public:
+
+    // bump this whenever the layout of the file or the analysis stored in it changes
+    static const uint32_t Version = 1;
+
+    // FNV-1a, used to tell apart maps with the same name and different terrain
+    static uint64_t hashBytes(const void * data, size_t size, uint64_t hash = 0xcbf29ce484222325ull);
+
+    // the file the cache of a map is stored in
+    static std::string getPath(const std::string & directory, const std::string & mapName, uint64_t hash);
+
+    // returns false, leaving data in an unspecified state, if the file is missing, doesn't match the map or holds
+    // tile indices or sector numbers outside of the map
+    static bool load(const std::string & path, const std::string & mapName, uint64_t hash, int width, int height, MapCacheData & data);
+    static bool save(const std::string & path, const MapCacheData & data);
+};
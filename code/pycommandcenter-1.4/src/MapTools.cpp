@@ -1,11 +1,20 @@
 #include "MapTools.h"
 #include "Util.h"
 #include "IDABot.h"
+#include "Unit.h"
+#include "BaseLocation.h"
+#include "ThreadPool.h"
 
+#ifdef SC2API
+#include <s2clientprotocol/sc2api.pb.h>
+#endif
+
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include <fstream>
 #include <array>
+#include <algorithm>
 
 namespace {
 	bool getBit(const sc2::ImageData& grid, int tileX, int tileY) {
@@ -21,6 +30,19 @@ namespace {
 		return (grid.data[idx.quot] >> (7 - idx.rem)) & 1;
 	}
 
+	// whether the distance a map holds for a walkable tile is still the one it would get if the map was computed now,
+	// that is the cheapest step onto the tile from one of its neighbours, as the search of the map would take it
+	bool hasConsistentDistance(const MapTools & map, const DistanceMap & distanceMap, int x, int y)
+	{
+		const CCTilePosition & start = distanceMap.getStartTile();
+		if (x == start.x && y == start.y)
+		{
+			return true;
+		}
+
+		return distanceMap.getStepDistance(map, x, y) == distanceMap.getDistanceGrid().get(x, y);
+	}
+
 }  // namespace
 
 
@@ -28,9 +50,13 @@ const size_t LegalActions = 4;
 const int actionX[LegalActions] ={1, -1, 0, 0};
 const int actionY[LegalActions] ={0, 0, 1, -1};
 
-typedef std::vector<std::vector<bool>> vvb;
-typedef std::vector<std::vector<int>>  vvi;
-typedef std::vector<std::vector<float>>  vvf;
+// values of the visibility grid, they match sc2::Visibility so the raw image can be copied as is
+const uint8_t TileHidden = 0;
+const uint8_t TileFogged = 1;
+const uint8_t TileVisible = 2;
+
+// how far around a new building we look for a way around it before flooding the whole sector
+const int LocalConnectivityMargin = 10;
 
 #ifdef SC2API
     #define HALF_TILE 0.5f
@@ -46,6 +72,12 @@ MapTools::MapTools(IDABot & bot)
     , m_height  (0)
     , m_maxZ    (0.0f)
     , m_frame   (0)
+    , m_floodGeneration (0)
+    , m_numSectors      (0)
+    , m_blockerUpdate   (0)
+    , m_walkableVersion (0)
+    , m_mapHash         (0)
+    , m_loadedFromMapCache (false)
 {
 
 }
@@ -61,31 +93,128 @@ void MapTools::onStart()
     m_height = BWAPI::Broodwar->mapHeight();
 #endif
 
-    m_walkable       = vvb(m_width, std::vector<bool>(m_height, true));
-    m_buildable      = vvb(m_width, std::vector<bool>(m_height, false));
-    m_depotBuildable = vvb(m_width, std::vector<bool>(m_height, false));
-    m_lastSeen       = vvi(m_width, std::vector<int>(m_height, 0));
-    m_sectorNumber   = vvi(m_width, std::vector<int>(m_height, 0));
-    m_terrainHeight  = vvf(m_width, std::vector<float>(m_height, 0.0f));
+    m_allMaps.clear();
+
+    m_walkable.reset(m_width, m_height, true);
+    m_buildable.reset(m_width, m_height, false);
+    m_depotBuildable.reset(m_width, m_height, false);
+    m_lastSeen.reset(m_width, m_height, 0);
+    m_visibility.reset(m_width, m_height, TileHidden);
+    m_sectorNumber.reset(m_width, m_height, 0);
+    m_terrainHeight.reset(m_width, m_height, 0.0f);
+    m_blockers.reset(m_width, m_height, 0);
+    m_floodStamp.reset(m_width, m_height, 0);
+    m_floodGeneration = 0;
+    m_blockingBuildings.clear();
+    m_walkableVersion++;
 
-    // Set the boolean grid data from the Map
-    for (int x(0); x < m_width; ++x)
+#ifdef SC2API
+    for (auto & unit : m_bot.Observation()->GetUnits())
     {
-        for (int y(0); y < m_height; ++y)
+        m_maxZ = std::max(unit->pos.z, m_maxZ);
+    }
+#endif
+
+    // the terrain analysis is the same every game on a map, so it is read from disk if an earlier game saved it
+    bool cached = loadMapCache();
+    if (!cached)
+    {
+        computeStaticGrids();
+    }
+
+    updateVisibility();
+
+    // no buildings are tracked yet, so the terrain is all there is
+    m_terrainWalkable = m_walkable;
+
+    if (!cached)
+    {
+        computeConnectivity();
+    }
+
+    m_hierarchicalPathFinder.build(*this);
+    m_regionMap.build(*this);
+}
+
+void MapTools::onFrame()
+{
+    m_frame++;
+
+    updateVisibility();
+
+    // a branch free pass over two flat buffers, which the compiler can vectorize
+    const uint8_t * visibility = m_visibility.data();
+    int * lastSeen = m_lastSeen.data();
+    const int frame = m_frame;
+    const size_t numTiles = m_lastSeen.size();
+
+    for (size_t i=0; i<numTiles; ++i)
+    {
+        lastSeen[i] = visibility[i] == TileVisible ? frame : lastSeen[i];
+    }
+}
+
+// reads the visibility of the whole map at once instead of asking the API tile by tile
+void MapTools::updateVisibility()
+{
+#ifdef SC2API
+    const SC2APIProtocol::Observation * observation = m_bot.Observation()->GetRawObservation();
+    if (observation != nullptr && observation->has_raw_data())
+    {
+        // one byte per tile, in the same row by row order as our grids
+        const SC2APIProtocol::ImageData & image = observation->raw_data().map_state().visibility();
+        if (image.bits_per_pixel() == 8 && image.size().x() == m_width && image.size().y() == m_height && image.data().size() >= m_visibility.size())
         {
-            m_buildable[x][y]       = canBuild(x, y);
-            m_depotBuildable[x][y]  = canBuild(x, y);
-            m_walkable[x][y]        = m_buildable[x][y] || canWalk(x, y);
-            m_terrainHeight[x][y]   = terrainHeight(CCPosition((CCPositionType)x, (CCPositionType)y));
+            std::memcpy(m_visibility.data(), image.data().data(), m_visibility.size());
+            return;
         }
     }
 
-#ifdef SC2API
-    for (auto & unit : m_bot.Observation()->GetUnits())
+    // fall back to asking for every tile if the image isn't in the format we expect
+    for (int y=0; y<m_height; ++y)
     {
-        m_maxZ = std::max(unit->pos.z, m_maxZ);
+        for (int x=0; x<m_width; ++x)
+        {
+            m_visibility.set(x, y, (uint8_t)m_bot.Observation()->GetVisibility(CCPosition(x + HALF_TILE, y + HALF_TILE)));
+        }
+    }
+#else
+    for (int y=0; y<m_height; ++y)
+    {
+        for (int x=0; x<m_width; ++x)
+        {
+            uint8_t visibility = TileHidden;
+            if (BWAPI::Broodwar->isVisible(BWAPI::TilePosition(x, y)))
+            {
+                visibility = TileVisible;
+            }
+            else if (BWAPI::Broodwar->isExplored(x, y))
+            {
+                visibility = TileFogged;
+            }
+
+            m_visibility.set(x, y, visibility);
+        }
     }
+#endif
+}
 
+void MapTools::computeStaticGrids()
+{
+    // Set the boolean grid data from the Map, row by row to match the grid layout
+    for (int y(0); y < m_height; ++y)
+    {
+        for (int x(0); x < m_width; ++x)
+        {
+            bool buildable = canBuild(x, y);
+            m_buildable.set(x, y, buildable);
+            m_depotBuildable.set(x, y, buildable);
+            m_walkable.set(x, y, buildable || canWalk(x, y));
+            m_terrainHeight.set(x, y, terrainHeight(CCPosition((CCPositionType)x, (CCPositionType)y)));
+        }
+    }
+
+#ifdef SC2API
     // set tiles that static resources are on as unbuildable
     for (auto & resource : m_bot.GetAllUnits())
     {
@@ -107,7 +236,7 @@ void MapTools::onStart()
         {
             for (int y=tileY; y<tileY+height; ++y)
             {
-                m_buildable[x][y] = false;
+                m_buildable.set(x, y, false);
 
                 // depots can't be built within 3 tiles of any resource
                 for (int rx=-3; rx<=3; rx++)
@@ -118,7 +247,7 @@ void MapTools::onStart()
                         if (std::abs(rx) + std::abs(ry) == 6) { continue; }
                         if (!isValidTile(CCTilePosition(x+rx, y+ry))) { continue; }
 
-                        m_depotBuildable[x+rx][y+ry] = false;
+                        m_depotBuildable.set(x+rx, y+ry, false);
                     }
                 }
             }
@@ -141,7 +270,7 @@ void MapTools::onStart()
         {
             for (int y=tileY; y<tileY+resource->getType().tileHeight(); ++y)
             {
-                m_buildable[x][y] = false;
+                m_buildable.set(x, y, false);
 
                 // depots can't be built within 3 tiles of any resource
                 for (int rx=-3; rx<=3; rx++)
@@ -153,7 +282,7 @@ void MapTools::onStart()
                             continue;
                         }
 
-                        m_depotBuildable[x+rx][y+ry] = false;
+                        m_depotBuildable.set(x+rx, y+ry, false);
                     }
                 }
             }
@@ -161,24 +290,134 @@ void MapTools::onStart()
     }
 
 #endif
+}
+
+uint64_t MapTools::computeMapHash() const
+{
+    uint64_t hash = MapCache::hashBytes(&m_width, sizeof(m_width));
+    hash = MapCache::hashBytes(&m_height, sizeof(m_height), hash);
+
+#ifdef SC2API
+    const sc2::GameInfo & info = m_bot.Observation()->GetGameInfo();
+    hash = MapCache::hashBytes(info.pathing_grid.data.data(), info.pathing_grid.data.size(), hash);
+    hash = MapCache::hashBytes(info.placement_grid.data.data(), info.placement_grid.data.size(), hash);
+    hash = MapCache::hashBytes(info.terrain_height.data.data(), info.terrain_height.data.size(), hash);
 
-    computeConnectivity();
+    // the depot buildable tiles also depend on where the resources are
+    for (auto & resource : m_bot.GetAllUnits())
+    {
+        if (resource.getType().isMineral() || resource.getType().isGeyser())
+        {
+            CCPosition pos = resource.getPosition();
+            hash = MapCache::hashBytes(&pos.x, sizeof(pos.x), hash);
+            hash = MapCache::hashBytes(&pos.y, sizeof(pos.y), hash);
+        }
+    }
+#endif
+
+    return hash;
 }
 
-void MapTools::onFrame()
+bool MapTools::loadMapCache()
 {
-    m_frame++;
+    m_mapHash = computeMapHash();
+    m_loadedFromMapCache = false;
+    m_cachedDepots.clear();
+
+#ifdef SC2API
+    if (m_mapCacheDirectory.empty())
+    {
+        return false;
+    }
+
+    MapCacheData data;
+    if (!MapCache::load(MapCache::getPath(m_mapCacheDirectory, m_mapName, m_mapHash), m_mapName, m_mapHash, m_width, m_height, data))
+    {
+        return false;
+    }
+
+    m_walkable = std::move(data.walkable);
+    m_buildable = std::move(data.buildable);
+    m_depotBuildable = std::move(data.depotBuildable);
+    m_terrainHeight = std::move(data.terrainHeight);
+    m_sectorNumber = std::move(data.sectorNumber);
+    m_numSectors = data.numSectors;
+
+    // the base locations pin their maps when they are created, which will find these
+    for (const MapCacheBase & base : data.bases)
+    {
+        m_allMaps.insert(base.center, base.distanceMap, true);
+        m_cachedDepots.push_back(std::make_pair(base.center, base.depot));
+    }
+
+    m_loadedFromMapCache = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void MapTools::saveMapCache(const std::vector<const BaseLocation *> & bases) const
+{
+#ifdef SC2API
+    if (m_mapCacheDirectory.empty() || m_loadedFromMapCache)
+    {
+        return;
+    }
+
+    MapCacheData data;
+    data.mapName = m_mapName;
+    data.hash = m_mapHash;
+    data.walkable = m_terrainWalkable;
+    data.buildable = m_buildable;
+    data.depotBuildable = m_depotBuildable;
+    data.terrainHeight = m_terrainHeight;
+    data.sectorNumber = m_sectorNumber;
+    data.numSectors = m_numSectors;
+
+    for (const BaseLocation * baseLocation : bases)
+    {
+        MapCacheBase base;
+        base.center = Util::GetTilePosition(baseLocation->getPosition());
+        base.depot = baseLocation->getDepotPosition();
+        base.distanceMap = getDistanceMap(base.center);
+        data.bases.push_back(base);
+    }
 
-    for (int x=0; x<m_width; ++x)
+    if (!MapCache::save(MapCache::getPath(m_mapCacheDirectory, m_mapName, m_mapHash), data))
+    {
+        std::cerr << "Could not write the map cache to " << m_mapCacheDirectory << std::endl;
+    }
+#endif
+}
+
+bool MapTools::getCachedDepotPosition(const CCTilePosition & center, CCTilePosition & depot) const
+{
+    for (auto & cached : m_cachedDepots)
     {
-        for (int y=0; y<m_height; ++y)
+        if (cached.first == center)
         {
-            if (isVisible(x, y))
-            {
-                m_lastSeen[x][y] = m_frame;
-            }
+            depot = cached.second;
+            return true;
         }
     }
+
+    return false;
+}
+
+void MapTools::setMapCacheDirectory(const std::string & directory)
+{
+    m_mapCacheDirectory = directory;
+}
+
+const std::string & MapTools::getMapCacheDirectory() const
+{
+    return m_mapCacheDirectory;
+}
+
+bool MapTools::isLoadedFromMapCache() const
+{
+    return m_loadedFromMapCache;
 }
 
 void MapTools::computeConnectivity()
@@ -189,12 +428,12 @@ void MapTools::computeConnectivity()
     int sectorNumber = 0;
 
     // for every tile on the map, do a connected flood fill using BFS
-    for (int x=0; x<m_width; ++x)
+    for (int y=0; y<m_height; ++y)
     {
-        for (int y=0; y<m_height; ++y)
+        for (int x=0; x<m_width; ++x)
         {
             // if the sector is not currently 0, or the map isn't walkable here, then we can skip this tile
-            if (getSectorNumber(x, y) != 0 || !isWalkable(x, y))
+            if (m_sectorNumber.get(x, y) != 0 || !m_walkable.get(x, y))
             {
                 continue;
             }
@@ -205,7 +444,7 @@ void MapTools::computeConnectivity()
             // reset the fringe for the search and add the start tile to it
             fringe.clear();
             fringe.push_back({x,y});
-            m_sectorNumber[x][y] = sectorNumber;
+            m_sectorNumber.set(x, y, sectorNumber);
 
             // do the BFS, stopping when we reach the last element of the fringe
             for (size_t fringeIndex=0; fringeIndex<fringe.size(); ++fringeIndex)
@@ -219,15 +458,298 @@ void MapTools::computeConnectivity()
                     int nextY = tile[1] + actionY[a];
 
                     // if the new tile is inside the map bounds, is walkable, and has not been assigned a sector, add it to the current sector and the fringe
-                    if (isValidTile(nextX, nextY) && isWalkable(nextX, nextY) && (getSectorNumber(nextX, nextY) == 0))
+                    if (isValidTile(nextX, nextY) && m_walkable.get(nextX, nextY) && (m_sectorNumber.get(nextX, nextY) == 0))
                     {
-                        m_sectorNumber[nextX][nextY] = sectorNumber;
+                        m_sectorNumber.set(nextX, nextY, sectorNumber);
                         fringe.push_back({nextX, nextY});
                     }
                 }
             }
         }
     }
+
+    m_numSectors = sectorNumber;
+}
+
+void MapTools::updateBlockers(const std::vector<Unit> & units)
+{
+    if (m_blockers.empty())
+    {
+        return;
+    }
+
+    m_blockerUpdate++;
+
+    // tiles whose number of buildings changed
+    std::vector<CCTilePosition> touched;
+
+    auto addFootprint = [this, &touched](const BuildingFootprint & footprint, int count)
+    {
+        for (int y = std::max(footprint.y, 0); y < footprint.y + footprint.height && y < m_height; ++y)
+        {
+            for (int x = std::max(footprint.x, 0); x < footprint.x + footprint.width && x < m_width; ++x)
+            {
+                m_blockers.set(x, y, (uint8_t)(m_blockers.get(x, y) + count));
+                touched.push_back(CCTilePosition(x, y));
+            }
+        }
+    };
+
+    for (auto & unit : units)
+    {
+        const UnitType & type = unit.getType();
+        if (!unit.isValid() || unit.isFlying() || !type.isBuilding() || type.isMineral() || type.isGeyser())
+        {
+            continue;
+        }
+
+        // the same footprint BuildingPlacer reserves for the building
+        BuildingFootprint footprint;
+        footprint.width = type.tileWidth();
+        footprint.height = type.tileHeight();
+        footprint.x = unit.getTilePosition().x - (int)std::ceil((footprint.width - 1.0) / 2);
+        footprint.y = unit.getTilePosition().y - (int)std::ceil((footprint.height - 1.0) / 2);
+        footprint.lastSeen = m_blockerUpdate;
+
+        auto it = m_blockingBuildings.find(unit.getID());
+        if (it == m_blockingBuildings.end())
+        {
+            addFootprint(footprint, 1);
+            m_blockingBuildings[unit.getID()] = footprint;
+            continue;
+        }
+
+        BuildingFootprint & old = it->second;
+        if (old.x != footprint.x || old.y != footprint.y || old.width != footprint.width || old.height != footprint.height)
+        {
+            addFootprint(old, -1);
+            addFootprint(footprint, 1);
+        }
+        old = footprint;
+    }
+
+    // buildings that weren't in the list anymore have died or lifted off
+    for (auto it = m_blockingBuildings.begin(); it != m_blockingBuildings.end(); )
+    {
+        if (it->second.lastSeen == m_blockerUpdate)
+        {
+            ++it;
+            continue;
+        }
+
+        addFootprint(it->second, -1);
+        it = m_blockingBuildings.erase(it);
+    }
+
+    if (touched.empty())
+    {
+        return;
+    }
+
+    std::vector<CCTilePosition> blocked;
+    std::vector<CCTilePosition> opened;
+
+    for (auto & tile : touched)
+    {
+        bool walkable = m_terrainWalkable.get(tile.x, tile.y) && m_blockers.get(tile.x, tile.y) == 0;
+        if (walkable == m_walkable.get(tile.x, tile.y))
+        {
+            continue;
+        }
+
+        m_walkable.set(tile.x, tile.y, walkable);
+        (walkable ? opened : blocked).push_back(tile);
+    }
+
+    if (blocked.empty() && opened.empty())
+    {
+        return;
+    }
+
+    m_walkableVersion++;
+    updateConnectivity(blocked, opened);
+
+    std::vector<CCTilePosition> changed(blocked);
+    changed.insert(changed.end(), opened.begin(), opened.end());
+    m_hierarchicalPathFinder.update(*this, changed);
+
+    // Blocking a tile can only make distances longer and opening one only shorter, and either way the first
+    // tiles to change are the walkable ones around it (or the opened tile itself). If all of those still hold
+    // the distance their neighbours give them, nothing further out changes and the map is kept. A tile that
+    // became blocked keeps its old distance in a kept map, which is harmless since nothing steps off it.
+    auto changesAround = [&](const DistanceMap & map, const std::vector<CCTilePosition> & tiles)
+    {
+        for (auto & tile : tiles)
+        {
+            for (int dy=-1; dy<=1; ++dy)
+            {
+                for (int dx=-1; dx<=1; ++dx)
+                {
+                    int x = tile.x + dx;
+                    int y = tile.y + dy;
+                    if (isWalkable(x, y) && !hasConsistentDistance(*this, map, x, y))
+                    {
+                        return true;
+                    }
+                }
+            }
+        }
+
+        return false;
+    };
+
+    m_allMaps.invalidate([&](const DistanceMap & map)
+    {
+        return changesAround(map, blocked) || changesAround(map, opened);
+    });
+}
+
+void MapTools::updateConnectivity(const std::vector<CCTilePosition> & blocked, const std::vector<CCTilePosition> & opened)
+{
+    // blocked tiles leave their sector, and the walkable tiles around them may no longer be connected
+    for (auto & tile : blocked)
+    {
+        m_sectorNumber.set(tile.x, tile.y, 0);
+    }
+
+    std::map<int, std::vector<CCTilePosition>> seeds;
+    for (auto & tile : blocked)
+    {
+        for (size_t a=0; a<LegalActions; ++a)
+        {
+            CCTilePosition next(tile.x + actionX[a], tile.y + actionY[a]);
+            if (isWalkable(next) && getSectorNumber(next.x, next.y) != 0)
+            {
+                seeds[getSectorNumber(next.x, next.y)].push_back(next);
+            }
+        }
+    }
+
+    for (auto & sectorSeeds : seeds)
+    {
+        splitSector(sectorSeeds.second);
+    }
+
+    // opened tiles join the sector next to them, and merge it with any other sector they touch
+    for (auto & tile : opened)
+    {
+        if (getSectorNumber(tile.x, tile.y) != 0)
+        {
+            continue;
+        }
+
+        int sector = 0;
+        for (size_t a=0; a<LegalActions && sector == 0; ++a)
+        {
+            sector = getSectorNumber(tile.x + actionX[a], tile.y + actionY[a]);
+        }
+
+        floodSector(tile, sector != 0 ? sector : ++m_numSectors);
+    }
+}
+
+// the seeds all had the same sector before some tiles were blocked, gives each part of it they now lie in its own sector
+void MapTools::splitSector(const std::vector<CCTilePosition> & seeds)
+{
+    // usually the tiles around a new building can still reach each other close by, then nothing changes
+    if (seeds.size() < 2 || isConnectedNearby(seeds))
+    {
+        return;
+    }
+
+    int sector = getSectorNumber(seeds[0].x, seeds[0].y);
+    for (auto & seed : seeds)
+    {
+        // seeds reached by an earlier flood already have their new sector
+        if (getSectorNumber(seed.x, seed.y) == sector)
+        {
+            floodSector(seed, ++m_numSectors);
+        }
+    }
+}
+
+// whether all the seeds are connected within a box around them, without looking at the rest of the map
+bool MapTools::isConnectedNearby(const std::vector<CCTilePosition> & seeds)
+{
+    int minX = seeds[0].x, maxX = seeds[0].x;
+    int minY = seeds[0].y, maxY = seeds[0].y;
+    for (auto & seed : seeds)
+    {
+        minX = std::min(minX, seed.x);
+        maxX = std::max(maxX, seed.x);
+        minY = std::min(minY, seed.y);
+        maxY = std::max(maxY, seed.y);
+    }
+
+    minX -= LocalConnectivityMargin;
+    maxX += LocalConnectivityMargin;
+    minY -= LocalConnectivityMargin;
+    maxY += LocalConnectivityMargin;
+
+    if (++m_floodGeneration == 0)
+    {
+        m_floodStamp.fill(0);
+        m_floodGeneration = 1;
+    }
+
+    std::vector<CCTilePosition> fringe;
+    fringe.push_back(seeds[0]);
+    m_floodStamp.set(seeds[0].x, seeds[0].y, m_floodGeneration);
+
+    for (size_t fringeIndex=0; fringeIndex<fringe.size(); ++fringeIndex)
+    {
+        CCTilePosition tile = fringe[fringeIndex];
+
+        for (size_t a=0; a<LegalActions; ++a)
+        {
+            int nextX = tile.x + actionX[a];
+            int nextY = tile.y + actionY[a];
+
+            if (nextX < minX || nextY < minY || nextX > maxX || nextY > maxY || !isWalkable(nextX, nextY) || m_floodStamp.get(nextX, nextY) == m_floodGeneration)
+            {
+                continue;
+            }
+
+            m_floodStamp.set(nextX, nextY, m_floodGeneration);
+            fringe.push_back(CCTilePosition(nextX, nextY));
+        }
+    }
+
+    for (auto & seed : seeds)
+    {
+        if (m_floodStamp.get(seed.x, seed.y) != m_floodGeneration)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// sets the sector of every walkable tile connected to start, walkable neighbours always share a
+// sector so this only ever spreads over the sectors that start is now connecting
+void MapTools::floodSector(const CCTilePosition & start, int sector)
+{
+    std::vector<CCTilePosition> fringe;
+    fringe.push_back(start);
+    m_sectorNumber.set(start.x, start.y, sector);
+
+    for (size_t fringeIndex=0; fringeIndex<fringe.size(); ++fringeIndex)
+    {
+        CCTilePosition tile = fringe[fringeIndex];
+
+        for (size_t a=0; a<LegalActions; ++a)
+        {
+            int nextX = tile.x + actionX[a];
+            int nextY = tile.y + actionY[a];
+
+            if (isWalkable(nextX, nextY) && m_sectorNumber.get(nextX, nextY) != sector)
+            {
+                m_sectorNumber.set(nextX, nextY, sector);
+                fringe.push_back(CCTilePosition(nextX, nextY));
+            }
+        }
+    }
 }
 
 bool MapTools::isExplored(const CCTilePosition & pos) const
@@ -242,25 +764,13 @@ bool MapTools::isExplored(const CCPosition & pos) const
 
 bool MapTools::isExplored(int tileX, int tileY) const
 {
-    if (!isValidTile(tileX, tileY)) { return false; }
-
-#ifdef SC2API
-    sc2::Visibility vis = m_bot.Observation()->GetVisibility(CCPosition(tileX + HALF_TILE, tileY + HALF_TILE));
-    return vis == sc2::Visibility::Fogged || vis == sc2::Visibility::Visible;
-#else
-    return BWAPI::Broodwar->isExplored(tileX, tileY);
-#endif
+    uint8_t visibility = m_visibility.at(tileX, tileY, TileHidden);
+    return visibility == TileFogged || visibility == TileVisible;
 }
 
 bool MapTools::isVisible(int tileX, int tileY) const
 {
-    if (!isValidTile(tileX, tileY)) { return false; }
-
-#ifdef SC2API
-    return m_bot.Observation()->GetVisibility(CCPosition(tileX + HALF_TILE, tileY + HALF_TILE)) == sc2::Visibility::Visible;
-#else
-    return BWAPI::Broodwar->isVisible(BWAPI::TilePosition(tileX, tileY));
-#endif
+    return m_visibility.at(tileX, tileY, TileHidden) == TileVisible;
 }
 
 bool MapTools::isPowered(int tileX, int tileY) const
@@ -282,7 +792,7 @@ bool MapTools::isPowered(int tileX, int tileY) const
 
 float MapTools::terrainHeight(float x, float y) const
 {
-    return m_terrainHeight[(int)x][(int)y];
+    return m_terrainHeight.at((int)x, (int)y, 0.0f);
 }
 
 //int MapTools::getGroundDistance(const CCPosition & src, const CCPosition & dest) const
@@ -290,42 +800,193 @@ float MapTools::terrainHeight(float x, float y) const
 //    return (int)Util::Dist(src, dest);
 //}
 
-int MapTools::getGroundDistance(const CCPosition & src, const CCPosition & dest) const
+int MapTools::getGroundDistance(const CCPosition & src, const CCPosition & dest, DistanceMetric metric) const
 {
-    if (m_allMaps.size() > 50)
+    CCTilePosition destTile = Util::GetTilePosition(dest);
+
+    // reuse a full distance map if we already have one for this destination
+    std::shared_ptr<const DistanceMap> map = m_allMaps.peek(destTile, metric);
+    if (map)
     {
-        m_allMaps.clear();
+        return map->getDistanceOnto(*this, Util::GetTilePosition(src));
     }
 
-    return getDistanceMap(dest).getDistance(src);
+    // otherwise search just between the two points, which gives the same distance as the map would
+    return m_pathFinder.search(*this, destTile, Util::GetTilePosition(src), metric);
+}
+
+std::vector<CCTilePosition> MapTools::getGroundPath(const CCPosition & src, const CCPosition & dest, DistanceMetric metric) const
+{
+    std::vector<CCTilePosition> path;
+    m_pathFinder.search(*this, Util::GetTilePosition(dest), Util::GetTilePosition(src), metric, &path);
+    return path;
+}
+
+int MapTools::getApproxGroundDistance(const CCPosition & src, const CCPosition & dest) const
+{
+    return m_hierarchicalPathFinder.search(*this, Util::GetTilePosition(dest), Util::GetTilePosition(src));
+}
+
+std::vector<CCTilePosition> MapTools::getApproxGroundPath(const CCPosition & src, const CCPosition & dest) const
+{
+    std::vector<CCTilePosition> path;
+    m_hierarchicalPathFinder.search(*this, Util::GetTilePosition(dest), Util::GetTilePosition(src), &path);
+    return path;
 }
 
-const DistanceMap & MapTools::getDistanceMap(const CCPosition & pos) const
+const HierarchicalPathFinder & MapTools::getHierarchicalPathFinder() const
 {
-    return getDistanceMap(Util::GetTilePosition(pos));
+    return m_hierarchicalPathFinder;
 }
 
-const DistanceMap & MapTools::getDistanceMap(const CCTilePosition & tile) const
+std::shared_ptr<const DistanceMap> MapTools::getDistanceMap(const CCPosition & pos, DistanceMetric metric) const
 {
-    std::pair<int,int> pairTile(tile.x, tile.y);
+    return getDistanceMap(Util::GetTilePosition(pos), metric);
+}
 
-    if (m_allMaps.find(pairTile) == m_allMaps.end())
+std::shared_ptr<const DistanceMap> MapTools::getDistanceMap(const CCTilePosition & tile, DistanceMetric metric) const
+{
+    std::shared_ptr<const DistanceMap> map = m_allMaps.find(tile, metric);
+    if (map)
     {
-        m_allMaps[pairTile] = DistanceMap();
-        m_allMaps[pairTile].computeDistanceMap(m_bot, tile);
+        return map;
     }
 
-    return m_allMaps[pairTile];
+    auto computed = std::make_shared<DistanceMap>();
+    computed->computeDistanceMap(m_bot, tile, metric);
+    m_allMaps.insert(tile, computed);
+    return computed;
 }
 
-int MapTools::getSectorNumber(int x, int y) const
+std::shared_ptr<const DistanceMap> MapTools::pinDistanceMap(const CCPosition & pos) const
+{
+    return pinDistanceMap(Util::GetTilePosition(pos));
+}
+
+std::shared_ptr<const DistanceMap> MapTools::pinDistanceMap(const CCTilePosition & tile) const
+{
+    std::shared_ptr<const DistanceMap> map = getDistanceMap(tile);
+    m_allMaps.setPinned(tile, DistanceMetric::FourConnected, true);
+    return map;
+}
+
+void MapTools::pinDistanceMaps(const std::vector<CCTilePosition> & tiles) const
 {
-    if (!isValidTile(x, y))
+    std::vector<CCTilePosition> missing;
+    for (auto & tile : tiles)
     {
-        return 0;
+        if (std::find(missing.begin(), missing.end(), tile) == missing.end() && !m_allMaps.find(tile))
+        {
+            missing.push_back(tile);
+        }
     }
 
-    return m_sectorNumber[x][y];
+    // the maps only read the walkable grid and each is computed by one thread, so they come out the same as computed one by one
+    std::vector<std::shared_ptr<DistanceMap>> computed(missing.size());
+    ThreadPool::get().parallelFor(missing.size(), 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i=begin; i<end; ++i)
+        {
+            computed[i] = std::make_shared<DistanceMap>();
+            computed[i]->computeDistanceMap(*this, missing[i]);
+        }
+    });
+
+    // only this thread touches the cache
+    for (size_t i=0; i<missing.size(); ++i)
+    {
+        m_allMaps.insert(missing[i], computed[i], true);
+    }
+
+    for (auto & tile : tiles)
+    {
+        m_allMaps.setPinned(tile, DistanceMetric::FourConnected, true);
+    }
+}
+
+const DistanceMapCacheStats & MapTools::getDistanceMapCacheStats() const
+{
+    return m_allMaps.getStats();
+}
+
+void MapTools::setDistanceMapCacheBudget(size_t bytes)
+{
+    m_allMaps.setBudget(bytes);
+}
+
+const std::vector<Region> & MapTools::getRegions() const
+{
+    return m_regionMap.getRegions();
+}
+
+const std::vector<Chokepoint> & MapTools::getChokepoints() const
+{
+    return m_regionMap.getChokepoints();
+}
+
+const Region * MapTools::getRegion(int tileX, int tileY) const
+{
+    return m_regionMap.getRegion(tileX, tileY);
+}
+
+const Region * MapTools::getRegion(const CCTilePosition & tile) const
+{
+    return getRegion(tile.x, tile.y);
+}
+
+const Region * MapTools::getRegion(const CCPosition & pos) const
+{
+    return getRegion(Util::GetTilePosition(pos));
+}
+
+float MapTools::getAltitude(int tileX, int tileY) const
+{
+    return m_regionMap.getAltitude(tileX, tileY);
+}
+
+const TileGrid<bool> & MapTools::getWalkableGrid() const
+{
+    return m_walkable;
+}
+
+const TileGrid<bool> & MapTools::getTerrainWalkableGrid() const
+{
+    return m_terrainWalkable;
+}
+
+const TileGrid<bool> & MapTools::getBuildableGrid() const
+{
+    return m_buildable;
+}
+
+const TileGrid<bool> & MapTools::getDepotBuildableGrid() const
+{
+    return m_depotBuildable;
+}
+
+const TileGrid<int> & MapTools::getSectorGrid() const
+{
+    return m_sectorNumber;
+}
+
+const TileGrid<float> & MapTools::getTerrainHeightGrid() const
+{
+    return m_terrainHeight;
+}
+
+const TileGrid<int> & MapTools::getLastSeenGrid() const
+{
+    return m_lastSeen;
+}
+
+const TileGrid<uint8_t> & MapTools::getVisibilityGrid() const
+{
+    return m_visibility;
+}
+
+int MapTools::getSectorNumber(int x, int y) const
+{
+    return m_sectorNumber.at(x, y, 0);
 }
 
 bool MapTools::isValidTile(int tileX, int tileY) const
@@ -470,12 +1131,7 @@ bool MapTools::isConnected(const CCPosition & p1, const CCPosition & p2) const
 
 bool MapTools::isBuildable(int tileX, int tileY) const
 {
-    if (!isValidTile(tileX, tileY))
-    {
-        return false;
-    }
-
-    return m_buildable[tileX][tileY];
+    return m_buildable.at(tileX, tileY, false);
 }
 
 bool MapTools::canBuildTypeAtPosition(int tileX, int tileY, const UnitType & type) const
@@ -487,6 +1143,31 @@ bool MapTools::canBuildTypeAtPosition(int tileX, int tileY, const UnitType & typ
 #endif
 }
 
+std::vector<bool> MapTools::canBuildTypeAtPositions(const std::vector<CCTilePosition> & tiles, const UnitType & type) const
+{
+#ifdef SC2API
+    std::vector<sc2::QueryInterface::PlacementQuery> queries;
+    queries.reserve(tiles.size());
+    for (auto & tile : tiles)
+    {
+        queries.push_back(sc2::QueryInterface::PlacementQuery(m_bot.Data(type).buildAbility, CCPosition((float)tile.x, (float)tile.y)));
+    }
+
+    std::vector<bool> results = m_bot.Query()->Placement(queries);
+
+    // a failed query gives no answers, which counts as not being able to build anywhere
+    results.resize(tiles.size(), false);
+    return results;
+#else
+    std::vector<bool> results;
+    for (auto & tile : tiles)
+    {
+        results.push_back(canBuildTypeAtPosition(tile.x, tile.y, type));
+    }
+    return results;
+#endif
+}
+
 bool MapTools::isBuildable(const CCTilePosition & tile) const
 {
     return isBuildable(tile.x, tile.y);
@@ -512,22 +1193,12 @@ void MapTools::printMap()
 
 bool MapTools::isDepotBuildableTile(int tileX, int tileY) const
 {
-    if (!isValidTile(tileX, tileY))
-    {
-        return false;
-    }
-
-    return m_depotBuildable[tileX][tileY];
+    return m_depotBuildable.at(tileX, tileY, false);
 }
 
 bool MapTools::isWalkable(int tileX, int tileY) const
 {
-    if (!isValidTile(tileX, tileY))
-    {
-        return false;
-    }
-
-    return m_walkable[tileX][tileY];
+    return m_walkable.at(tileX, tileY, false);
 }
 
 bool MapTools::isWalkable(const CCTilePosition & tile) const
@@ -535,6 +1206,26 @@ bool MapTools::isWalkable(const CCTilePosition & tile) const
     return isWalkable(tile.x, tile.y);
 }
 
+bool MapTools::isTerrainWalkable(int tileX, int tileY) const
+{
+    return m_terrainWalkable.at(tileX, tileY, false);
+}
+
+bool MapTools::isTerrainWalkable(const CCTilePosition & tile) const
+{
+    return isTerrainWalkable(tile.x, tile.y);
+}
+
+bool MapTools::isBlocked(int tileX, int tileY) const
+{
+    return m_blockers.at(tileX, tileY, 0) > 0;
+}
+
+uint32_t MapTools::getWalkableVersion() const
+{
+    return m_walkableVersion;
+}
+
 int MapTools::width() const
 {
     return m_width;
@@ -550,9 +1241,10 @@ std::string MapTools::name() const
 	return m_mapName;
 }
 
-const std::vector<CCTilePosition> & MapTools::getClosestTilesTo(const CCTilePosition & pos) const
+std::vector<CCTilePosition> MapTools::getClosestTilesTo(const CCTilePosition & pos) const
 {
-    return getDistanceMap(pos).getSortedTiles();
+    // a copy, the map the tiles belong to may be evicted or computed again while the caller still uses them
+    return getDistanceMap(pos)->getSortedTiles();
 }
 
 CCTilePosition MapTools::getLeastRecentlySeenTile() const
@@ -561,11 +1253,13 @@ CCTilePosition MapTools::getLeastRecentlySeenTile() const
     CCTilePosition leastSeen;
     const BaseLocation * baseLocation = m_bot.Bases().getPlayerStartingBaseLocation(Players::Self);
 
-    for (auto & tile : baseLocation->getClosestTiles())
+    std::shared_ptr<const DistanceMap> distanceMap = baseLocation->getDistanceMap();
+    for (size_t i(0); i < distanceMap->getNumSortedTiles(); ++i)
     {
+        CCTilePosition tile = distanceMap->getSortedTile(i);
         BOT_ASSERT(isValidTile(tile), "How is this tile not valid?");
 
-        int lastSeen = m_lastSeen[tile.x][tile.y];
+        int lastSeen = m_lastSeen.get(tile.x, tile.y);
         if (lastSeen < minSeen)
         {
             minSeen = lastSeen;
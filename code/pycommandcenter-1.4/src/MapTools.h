@@ -1,13 +1,32 @@
 #pragma once
 
+#include <map>
 #include <vector>
 #include "DistanceMap.h"
+#include "DistanceMapCache.h"
+#include "HierarchicalPathFinder.h"
+#include "MapCache.h"
+#include "PathFinder.h"
+#include "RegionMap.h"
+#include "TileGrid.h"
 #include "UnitType.h"
 
+class BaseLocation;
 class IDABot;
+class Unit;
 
 class MapTools
 {
+    // the tiles a building stands on, and the last update it was seen in
+    struct BuildingFootprint
+    {
+        int x;
+        int y;
+        int width;
+        int height;
+        int lastSeen;
+    };
+
     IDABot &	m_bot;
 	std::string m_mapName;
     int			m_width;
@@ -17,16 +36,48 @@ class MapTools
     
 
     // a cache of already computed distance maps, which is mutable since it only acts as a cache
-    mutable std::map<std::pair<int,int>, DistanceMap>   m_allMaps;   
-
-    std::vector<std::vector<bool>>  m_walkable;         // whether a tile is buildable (includes static resources)
-    std::vector<std::vector<bool>>  m_buildable;        // whether a tile is buildable (includes static resources)
-    std::vector<std::vector<bool>>  m_depotBuildable;   // whether a depot is buildable on a tile (illegal within 3 tiles of static resource)
-    std::vector<std::vector<int>>   m_lastSeen;         // the last time any of our units has seen this position on the map
-    std::vector<std::vector<int>>   m_sectorNumber;     // connectivity sector number, two tiles are ground connected if they have the same number
-    std::vector<std::vector<float>> m_terrainHeight;        // height of the map at x+0.5, y+0.5
+    mutable DistanceMapCache    m_allMaps;
+
+    // search buffers for point to point distance queries, mutable for the same reason
+    mutable PathFinder          m_pathFinder;
+
+    // cluster graph for fast approximate distance queries, built in onStart
+    mutable HierarchicalPathFinder m_hierarchicalPathFinder;
+
+    // regions and chokepoints of the terrain, built in onStart
+    RegionMap                   m_regionMap;
+
+    TileGrid<bool>      m_walkable;         // whether a tile is walkable right now (includes static resources, excludes buildings)
+    TileGrid<bool>      m_terrainWalkable;  // whether the terrain of a tile is walkable, ignoring buildings
+    TileGrid<uint8_t>   m_blockers;         // the number of buildings standing on a tile
+    TileGrid<bool>      m_buildable;        // whether a tile is buildable (includes static resources)
+    TileGrid<bool>      m_depotBuildable;   // whether a depot is buildable on a tile (illegal within 3 tiles of static resource)
+    TileGrid<int>       m_lastSeen;         // the last time any of our units has seen this position on the map
+    TileGrid<uint8_t>   m_visibility;       // the visibility of every tile this frame, hidden (0), fogged (1) or visible (2)
+    TileGrid<int>       m_sectorNumber;     // connectivity sector number, two tiles are ground connected if they have the same number
+    TileGrid<float>     m_terrainHeight;    // height of the map at x+0.5, y+0.5
+    TileGrid<uint32_t>  m_floodStamp;       // marks the tiles visited by the last local connectivity check
+    uint32_t            m_floodGeneration;
+    int                 m_numSectors;
+    int                 m_blockerUpdate;
+    uint32_t            m_walkableVersion;
+
+    std::map<CCUnitID, BuildingFootprint> m_blockingBuildings;
+
+    std::string                 m_mapCacheDirectory;    // where the static map analysis is saved between games, empty to not save it
+    uint64_t                    m_mapHash;
+    bool                        m_loadedFromMapCache;
+    std::vector<std::pair<CCTilePosition, CCTilePosition>> m_cachedDepots;    // (resource center, depot) of the cached bases
     
+    void computeStaticGrids();
+    uint64_t computeMapHash() const;
+    bool loadMapCache();
     void computeConnectivity();
+    void updateVisibility();
+    void updateConnectivity(const std::vector<CCTilePosition> & blocked, const std::vector<CCTilePosition> & opened);
+    void splitSector(const std::vector<CCTilePosition> & seeds);
+    bool isConnectedNearby(const std::vector<CCTilePosition> & seeds);
+    void floodSector(const CCTilePosition & start, int sector);
 
     int getSectorNumber(int x, int y) const;
         
@@ -43,6 +94,20 @@ public:
     void    onStart();
     void    onFrame();
 
+    // marks the tiles under the given buildings as unwalkable and the tiles of buildings that are gone as
+    // walkable again, then updates connectivity and drops the cached distance maps that changed
+    void    updateBlockers(const std::vector<Unit> & units);
+
+    // the directory the terrain analysis and base distance maps are saved in, so later games on
+    // the same map can load them in onStart instead of computing them, empty (the default) to not save them
+    void    setMapCacheDirectory(const std::string & directory);
+    const   std::string & getMapCacheDirectory() const;
+    bool    isLoadedFromMapCache() const;
+    // saves the analysis once the base locations exist, unless it was loaded from the cache
+    void    saveMapCache(const std::vector<const BaseLocation *> & bases) const;
+    // the depot position an earlier game found for the base around the resource center tile
+    bool    getCachedDepotPosition(const CCTilePosition & center, CCTilePosition & depot) const;
+
 
     int     width() const;
     int     height() const;
@@ -70,15 +135,38 @@ public:
     bool    isExplored(const CCTilePosition & pos) const;
     bool    isVisible(int tileX, int tileY) const;
     bool    canBuildTypeAtPosition(int tileX, int tileY, const UnitType & type) const;
-
-    const   DistanceMap & getDistanceMap(const CCTilePosition & tile) const;
-    const   DistanceMap & getDistanceMap(const CCPosition & tile) const;
-    int     getGroundDistance(const CCPosition & src, const CCPosition & dest) const;
+    // like canBuildTypeAtPosition for many tiles, asking the game about all of them in one round trip
+    std::vector<bool> canBuildTypeAtPositions(const std::vector<CCTilePosition> & tiles, const UnitType & type) const;
+
+    // shared handle to the cached map, which stays valid even if the cache evicts it or buildings change the walkable tiles
+    std::shared_ptr<const DistanceMap> getDistanceMap(const CCTilePosition & tile, DistanceMetric metric = DistanceMetric::FourConnected) const;
+    std::shared_ptr<const DistanceMap> getDistanceMap(const CCPosition & pos, DistanceMetric metric = DistanceMetric::FourConnected) const;
+    // like getDistanceMap, but the map is never evicted from the cache
+    std::shared_ptr<const DistanceMap> pinDistanceMap(const CCTilePosition & tile) const;
+    std::shared_ptr<const DistanceMap> pinDistanceMap(const CCPosition & pos) const;
+    // pins the maps of all the tiles, computing the missing ones side by side on a pool of worker threads
+    void    pinDistanceMaps(const std::vector<CCTilePosition> & tiles) const;
+    const   DistanceMapCacheStats & getDistanceMapCacheStats() const;
+    void    setDistanceMapCacheBudget(size_t bytes);
+    int     getGroundDistance(const CCPosition & src, const CCPosition & dest, DistanceMetric metric = DistanceMetric::FourConnected) const;
+    // the tiles of a shortest ground path from src to dest, empty if there is none
+    std::vector<CCTilePosition> getGroundPath(const CCPosition & src, const CCPosition & dest, DistanceMetric metric = DistanceMetric::FourConnected) const;
+    // like getGroundDistance and getGroundPath but searches the cluster graph, much faster but may overshoot by a few tiles
+    int     getApproxGroundDistance(const CCPosition & src, const CCPosition & dest) const;
+    std::vector<CCTilePosition> getApproxGroundPath(const CCPosition & src, const CCPosition & dest) const;
+    const   HierarchicalPathFinder & getHierarchicalPathFinder() const;
     bool    isConnected(int x1, int y1, int x2, int y2) const;
     bool    isConnected(const CCTilePosition & from, const CCTilePosition & to) const;
     bool    isConnected(const CCPosition & from, const CCPosition & to) const;
     bool    isWalkable(int tileX, int tileY) const;
     bool    isWalkable(const CCTilePosition & tile) const;
+    // whether the terrain of the tile is walkable, as isWalkable but ignoring buildings
+    bool    isTerrainWalkable(int tileX, int tileY) const;
+    bool    isTerrainWalkable(const CCTilePosition & tile) const;
+    // whether a building stands on the tile
+    bool    isBlocked(int tileX, int tileY) const;
+    // changes every time a tile becomes walkable or unwalkable, so copies of the walkable tiles can tell they are out of date
+    uint32_t getWalkableVersion() const;
     
     bool    isBuildable(int tileX, int tileY) const;
     bool    isBuildable(const CCTilePosition & tile) const;
@@ -86,7 +174,26 @@ public:
     
     CCTilePosition getLeastRecentlySeenTile() const;
 
+    const   std::vector<Region> & getRegions() const;
+    const   std::vector<Chokepoint> & getChokepoints() const;
+    // the region a tile lies in, nullptr for unwalkable tiles
+    const   Region * getRegion(int tileX, int tileY) const;
+    const   Region * getRegion(const CCTilePosition & tile) const;
+    const   Region * getRegion(const CCPosition & pos) const;
+    // distance in tiles to the closest unwalkable tile
+    float   getAltitude(int tileX, int tileY) const;
+
+    // the whole grids at once, indexed by y * width + x, for handing entire maps to Python
+    const   TileGrid<bool> & getWalkableGrid() const;
+    const   TileGrid<bool> & getTerrainWalkableGrid() const;
+    const   TileGrid<bool> & getBuildableGrid() const;
+    const   TileGrid<bool> & getDepotBuildableGrid() const;
+    const   TileGrid<int> & getSectorGrid() const;
+    const   TileGrid<float> & getTerrainHeightGrid() const;
+    const   TileGrid<int> & getLastSeenGrid() const;
+    const   TileGrid<uint8_t> & getVisibilityGrid() const;
+
     // returns a list of all tiles on the map, sorted by 4-direcitonal walk distance from the given position
-    const std::vector<CCTilePosition> & getClosestTilesTo(const CCTilePosition & pos) const;
+    std::vector<CCTilePosition> getClosestTilesTo(const CCTilePosition & pos) const;
 };
 
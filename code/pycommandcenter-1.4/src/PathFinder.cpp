@@ -0,0 +1,195 @@
+#include "PathFinder.h"
+#include "MapTools.h"
+
+#include <algorithm>
+
+// the four straight moves followed by the four diagonal ones, four connected searches only use the first four
+const size_t LegalActions = 8;
+const int actionX[LegalActions] = {1, -1, 0, 0, 1, 1, -1, -1};
+const int actionY[LegalActions] = {0, 0, 1, -1, 1, -1, 1, -1};
+
+namespace
+{
+    // never overestimates the remaining distance, so the first time the goal is popped its cost is exact
+    int heuristic(int dx, int dy, DistanceMetric metric)
+    {
+        dx = std::abs(dx);
+        dy = std::abs(dy);
+
+        if (metric == DistanceMetric::Octile)
+        {
+            return DistanceMap::OctileStraightCost * std::max(dx, dy) + (DistanceMap::OctileDiagonalCost - DistanceMap::OctileStraightCost) * std::min(dx, dy);
+        }
+
+        return dx + dy;
+    }
+}
+
+PathFinder::PathFinder()
+    : m_width(0)
+    , m_height(0)
+    , m_generation(0)
+{
+
+}
+
+// resizes the buffers if the map changed and starts a new search generation,
+// which marks every tile as unvisited without touching the buffers
+void PathFinder::prepare(int width, int height)
+{
+    if (width != m_width || height != m_height)
+    {
+        m_width = width;
+        m_height = height;
+        m_visited.assign((size_t)width * height, 0);
+        m_cost.assign((size_t)width * height, 0);
+        m_parent.assign((size_t)width * height, 0);
+        m_generation = 0;
+    }
+
+    if (++m_generation == 0)
+    {
+        std::fill(m_visited.begin(), m_visited.end(), 0);
+        m_generation = 1;
+    }
+
+    m_open.clear();
+}
+
+int PathFinder::search(const MapTools & map, const CCTilePosition & start, const CCTilePosition & goal, DistanceMetric metric, std::vector<CCTilePosition> * path)
+{
+    if (path != nullptr)
+    {
+        path->clear();
+    }
+
+    if (!map.isValidTile(start) || !map.isValidTile(goal))
+    {
+        return -1;
+    }
+
+    if (start == goal)
+    {
+        if (path != nullptr)
+        {
+            path->push_back(goal);
+        }
+        return 0;
+    }
+
+    // a goal that isn't walkable can only be stepped onto if it is walkable ground under a building,
+    // and then one of its walkable neighbours has to share a sector with the start instead of the goal itself
+    bool goalUnderBuilding = !map.isWalkable(goal);
+    if (goalUnderBuilding && (!map.isBlocked(goal.x, goal.y) || !map.isTerrainWalkable(goal)))
+    {
+        return -1;
+    }
+
+    if (map.isWalkable(start))
+    {
+        bool connected = !goalUnderBuilding && map.isConnected(start, goal);
+        for (int dy=-1; dy<=1 && goalUnderBuilding && !connected; ++dy)
+        {
+            for (int dx=-1; dx<=1 && !connected; ++dx)
+            {
+                connected = map.isWalkable(goal.x + dx, goal.y + dy) && map.isConnected(start.x, start.y, goal.x + dx, goal.y + dy);
+            }
+        }
+
+        if (!connected)
+        {
+            return -1;
+        }
+    }
+
+    prepare(map.width(), map.height());
+
+    uint32_t startIndex = (uint32_t)(start.y * m_width + start.x);
+    uint32_t goalIndex = (uint32_t)(goal.y * m_width + goal.x);
+
+    m_visited[startIndex] = m_generation;
+    m_cost[startIndex] = 0;
+    m_parent[startIndex] = startIndex;
+    m_open.push_back({ heuristic(goal.x - start.x, goal.y - start.y, metric), 0, startIndex });
+
+    bool octile = metric == DistanceMetric::Octile;
+    size_t numActions = octile ? 8 : 4;
+
+    while (!m_open.empty())
+    {
+        std::pop_heap(m_open.begin(), m_open.end());
+        Node node = m_open.back();
+        m_open.pop_back();
+
+        // skip stale heap entries for tiles we have since reached more cheaply
+        if (node.g > m_cost[node.index])
+        {
+            continue;
+        }
+
+        if (node.index == goalIndex)
+        {
+            break;
+        }
+
+        int x = node.index % m_width;
+        int y = node.index / m_width;
+
+        // check every possible child of this tile
+        for (size_t a=0; a<numActions; ++a)
+        {
+            int nextX = x + actionX[a];
+            int nextY = y + actionY[a];
+
+            // a goal under a building is the one unwalkable tile we may step onto
+            if (!map.isWalkable(nextX, nextY) && !(goalUnderBuilding && nextX == goal.x && nextY == goal.y))
+            {
+                continue;
+            }
+
+            uint32_t nextIndex = (uint32_t)(nextY * m_width + nextX);
+
+            bool diagonal = a >= 4;
+
+            // a diagonal step may not cut the corner of a blocked tile, same as in DistanceMap
+            if (diagonal && (!map.isWalkable(x + actionX[a], y) || !map.isWalkable(x, y + actionY[a])))
+            {
+                continue;
+            }
+
+            int nextCost = node.g + (!octile ? 1 : diagonal ? DistanceMap::OctileDiagonalCost : DistanceMap::OctileStraightCost);
+
+            if (m_visited[nextIndex] == m_generation && m_cost[nextIndex] <= nextCost)
+            {
+                continue;
+            }
+
+            m_visited[nextIndex] = m_generation;
+            m_cost[nextIndex] = nextCost;
+            m_parent[nextIndex] = node.index;
+
+            m_open.push_back({ nextCost + heuristic(goal.x - nextX, goal.y - nextY, metric), nextCost, nextIndex });
+            std::push_heap(m_open.begin(), m_open.end());
+        }
+    }
+
+    if (m_visited[goalIndex] != m_generation)
+    {
+        return -1;
+    }
+
+    if (path != nullptr)
+    {
+        for (uint32_t index = goalIndex; ; index = m_parent[index])
+        {
+            path->push_back(CCTilePosition(index % m_width, index / m_width));
+            if (index == startIndex)
+            {
+                break;
+            }
+        }
+    }
+
+    // octile costs are in fifths of a tile, round them to whole tiles like DistanceMap does
+    return octile ? (m_cost[goalIndex] + DistanceMap::OctileStraightCost / 2) / DistanceMap::OctileStraightCost : m_cost[goalIndex];
+}
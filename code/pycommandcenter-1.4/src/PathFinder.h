@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Common.h"
+#include "DistanceMap.h"
+#include <vector>
+
+class MapTools;
+
+// Answers single ground distance queries between two tiles with an A* search
+// over the walkable grid, instead of flooding the whole map like DistanceMap.
+// It moves between tiles with the same rules and costs as a DistanceMap of the
+// same metric, so the distances are identical to DistanceMap::getDistance. The
+// search buffers are kept between queries so a query does not allocate.
+class PathFinder
+{
+    struct Node
+    {
+        int         f;
+        int         g;
+        uint32_t    index;
+
+        // the heap is a max-heap, so the node with the lowest f (and highest g on ties) should compare greatest
+        bool operator < (const Node & rhs) const
+        {
+            return f > rhs.f || (f == rhs.f && g < rhs.g);
+        }
+    };
+
+    int                     m_width;
+    int                     m_height;
+    uint32_t                m_generation;
+    std::vector<uint32_t>   m_visited;      // tile was reached in the search of this generation
+    std::vector<int>        m_cost;         // cheapest known distance from the start tile
+    std::vector<uint32_t>   m_parent;       // the tile we came from, used to rebuild the path
+    std::vector<Node>       m_open;
+
+    void prepare(int width, int height);
+
+public:
+
+    PathFinder();
+
+    // Returns the ground distance from start to goal, or -1 if goal can't be reached.
+    // The start tile does not have to be walkable. The goal does, unless it is walkable terrain under a building,
+    // which is stepped onto the same way as in DistanceMap::getDistanceOnto so a unit on a building still has a distance.
+    // If path is given, it is filled with the tiles from goal back to start.
+    int search(const MapTools & map, const CCTilePosition & start, const CCTilePosition & goal, DistanceMetric metric = DistanceMetric::FourConnected, std::vector<CCTilePosition> * path = nullptr);
+};
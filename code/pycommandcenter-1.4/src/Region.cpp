@@ -0,0 +1,110 @@
+#include "Region.h"
+
+#include <algorithm>
+
+Chokepoint::Chokepoint()
+    : m_id(-1)
+    , m_regionA(nullptr)
+    , m_regionB(nullptr)
+    , m_width(0.0f)
+{
+
+}
+
+int Chokepoint::getId() const
+{
+    return m_id;
+}
+
+const Region * Chokepoint::getRegionA() const
+{
+    return m_regionA;
+}
+
+const Region * Chokepoint::getRegionB() const
+{
+    return m_regionB;
+}
+
+const Region * Chokepoint::getOtherRegion(const Region * region) const
+{
+    if (region == m_regionA)
+    {
+        return m_regionB;
+    }
+
+    if (region == m_regionB)
+    {
+        return m_regionA;
+    }
+
+    return nullptr;
+}
+
+const CCTilePosition & Chokepoint::getCenter() const
+{
+    return m_center;
+}
+
+const CCTilePosition & Chokepoint::getSideA() const
+{
+    return m_sideA;
+}
+
+const CCTilePosition & Chokepoint::getSideB() const
+{
+    return m_sideB;
+}
+
+float Chokepoint::getWidth() const
+{
+    return m_width;
+}
+
+const std::vector<CCTilePosition> & Chokepoint::getTiles() const
+{
+    return m_tiles;
+}
+
+Region::Region()
+    : m_id(-1)
+    , m_numTiles(0)
+    , m_altitude(0)
+{
+
+}
+
+int Region::getId() const
+{
+    return m_id;
+}
+
+int Region::getNumTiles() const
+{
+    return m_numTiles;
+}
+
+int Region::getAltitude() const
+{
+    return m_altitude;
+}
+
+const CCTilePosition & Region::getCenter() const
+{
+    return m_center;
+}
+
+const std::vector<const Chokepoint *> & Region::getChokepoints() const
+{
+    return m_chokepoints;
+}
+
+const std::vector<const Region *> & Region::getNeighbours() const
+{
+    return m_neighbours;
+}
+
+bool Region::isNeighbour(const Region * region) const
+{
+    return std::find(m_neighbours.begin(), m_neighbours.end(), region) != m_neighbours.end();
+}
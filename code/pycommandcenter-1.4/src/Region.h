@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Common.h"
+#include <vector>
+
+class Region;
+
+// A narrow passage on the boundary between two regions. Its tiles form a line
+// across the passage, running from one side of it to the other.
+class Chokepoint
+{
+    friend class RegionMap;
+
+    int                             m_id;
+    const Region *                  m_regionA;
+    const Region *                  m_regionB;
+    CCTilePosition                  m_center;
+    CCTilePosition                  m_sideA;
+    CCTilePosition                  m_sideB;
+    float                           m_width;
+    std::vector<CCTilePosition>     m_tiles;
+
+public:
+
+    Chokepoint();
+
+    int getId() const;
+    const Region * getRegionA() const;
+    const Region * getRegionB() const;
+    // returns the region on the other side of the chokepoint, or nullptr if region isn't one of its two
+    const Region * getOtherRegion(const Region * region) const;
+    const CCTilePosition & getCenter() const;
+    // the two end tiles of the line across the chokepoint
+    const CCTilePosition & getSideA() const;
+    const CCTilePosition & getSideB() const;
+    // distance in tiles between the two sides
+    float getWidth() const;
+    const std::vector<CCTilePosition> & getTiles() const;
+};
+
+// An area of the walkable map, separated from its neighbouring regions by chokepoints.
+class Region
+{
+    friend class RegionMap;
+
+    int                             m_id;
+    int                             m_numTiles;
+    int                             m_altitude;
+    CCTilePosition                  m_center;
+    std::vector<const Chokepoint *> m_chokepoints;
+    std::vector<const Region *>     m_neighbours;
+
+public:
+
+    Region();
+
+    int getId() const;
+    int getNumTiles() const;
+    // distance from the center to the closest unwalkable tile, how open the region is
+    int getAltitude() const;
+    // the tile furthest away from any unwalkable tile
+    const CCTilePosition & getCenter() const;
+    const std::vector<const Chokepoint *> & getChokepoints() const;
+    const std::vector<const Region *> & getNeighbours() const;
+    bool isNeighbour(const Region * region) const;
+};
@@ -0,0 +1,407 @@
+#include "RegionMap.h"
+#include "MapTools.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <map>
+
+const size_t LegalActions = 4;
+const int actionX[LegalActions] = {1, -1, 0, 0};
+const int actionY[LegalActions] = {0, 0, 1, -1};
+
+// altitudes are measured in fifths of a tile, a diagonal step counts as 7/5 ~ sqrt(2)
+const int AltitudeStraightCost = 5;
+const int AltitudeDiagonalCost = 7;
+
+// regions smaller or lower than this are always merged into their neighbour instead of getting a chokepoint
+const int MinRegionTiles = 64;
+const int MinRegionAltitude = 4 * AltitudeStraightCost;
+
+// two regions meeting at a tile this close to the altitude of either of them are not separated by a chokepoint
+const int MergeAltitudePercent = 90;
+
+namespace
+{
+    int findRoot(std::vector<int> & parent, int i)
+    {
+        while (parent[i] != i)
+        {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+
+        return i;
+    }
+}
+
+RegionMap::RegionMap()
+    : m_width(0)
+    , m_height(0)
+{
+
+}
+
+void RegionMap::clear()
+{
+    m_width = 0;
+    m_height = 0;
+    m_altitude.reset(0, 0);
+    m_regionId.reset(0, 0);
+    m_regions.clear();
+    m_chokepoints.clear();
+}
+
+void RegionMap::build(const MapTools & map)
+{
+    clear();
+
+    m_width = map.width();
+    m_height = map.height();
+
+    computeAltitude(map);
+    computeRegions(map);
+}
+
+// two pass chamfer distance transform, tiles outside the map count as unwalkable
+void RegionMap::computeAltitude(const MapTools & map)
+{
+    const int maxAltitude = std::numeric_limits<int>::max() / 2;
+    m_altitude.reset(m_width, m_height, 0);
+
+    auto altitudeAt = [this](int x, int y)
+    {
+        return m_altitude.at(x, y, 0);
+    };
+
+    for (int y=0; y<m_height; ++y)
+    {
+        for (int x=0; x<m_width; ++x)
+        {
+            if (!map.isWalkable(x, y))
+            {
+                continue;
+            }
+
+            int alt = maxAltitude;
+            alt = std::min(alt, altitudeAt(x-1, y  ) + AltitudeStraightCost);
+            alt = std::min(alt, altitudeAt(x-1, y-1) + AltitudeDiagonalCost);
+            alt = std::min(alt, altitudeAt(x,   y-1) + AltitudeStraightCost);
+            alt = std::min(alt, altitudeAt(x+1, y-1) + AltitudeDiagonalCost);
+            m_altitude.set(x, y, alt);
+        }
+    }
+
+    for (int y=m_height-1; y>=0; --y)
+    {
+        for (int x=m_width-1; x>=0; --x)
+        {
+            if (!map.isWalkable(x, y))
+            {
+                continue;
+            }
+
+            int alt = m_altitude.get(x, y);
+            alt = std::min(alt, altitudeAt(x+1, y  ) + AltitudeStraightCost);
+            alt = std::min(alt, altitudeAt(x+1, y+1) + AltitudeDiagonalCost);
+            alt = std::min(alt, altitudeAt(x,   y+1) + AltitudeStraightCost);
+            alt = std::min(alt, altitudeAt(x-1, y+1) + AltitudeDiagonalCost);
+            m_altitude.set(x, y, alt);
+        }
+    }
+}
+
+void RegionMap::computeRegions(const MapTools & map)
+{
+    m_regionId.reset(m_width, m_height, -1);
+
+    // visit the walkable tiles from the highest altitude down
+    std::vector<uint32_t> order;
+    for (int y=0; y<m_height; ++y)
+    {
+        for (int x=0; x<m_width; ++x)
+        {
+            if (map.isWalkable(x, y))
+            {
+                order.push_back((uint32_t)m_altitude.index(x, y));
+            }
+        }
+    }
+
+    const int * altitude = m_altitude.data();
+    std::stable_sort(order.begin(), order.end(), [altitude](uint32_t a, uint32_t b) { return altitude[a] > altitude[b]; });
+
+    // the regions grown so far, merged regions are joined in a union-find forest
+    std::vector<int> parent;
+    std::vector<int> numTiles;
+    std::vector<int> highest;
+    std::vector<uint32_t> highestTile;
+
+    // tiles where two regions met without being merged, with the two regions
+    std::vector<std::array<int, 3>> frontier;
+
+    int * regionId = m_regionId.data();
+
+    for (uint32_t index : order)
+    {
+        int x = index % m_width;
+        int y = index / m_width;
+        int alt = altitude[index];
+
+        // the regions next to this tile, how many of its neighbours are in each of them and how high they are
+        int neighbours[LegalActions];
+        int counts[LegalActions];
+        int heights[LegalActions];
+        size_t numNeighbours = 0;
+
+        for (size_t a=0; a<LegalActions; ++a)
+        {
+            int nextX = x + actionX[a];
+            int nextY = y + actionY[a];
+
+            if (!m_regionId.isValid(nextX, nextY) || m_regionId.get(nextX, nextY) < 0)
+            {
+                continue;
+            }
+
+            int region = findRoot(parent, m_regionId.get(nextX, nextY));
+            size_t n = 0;
+            while (n < numNeighbours && neighbours[n] != region) { ++n; }
+
+            if (n == numNeighbours)
+            {
+                neighbours[numNeighbours] = region;
+                counts[numNeighbours] = 0;
+                heights[numNeighbours] = 0;
+                numNeighbours++;
+            }
+            counts[n]++;
+            heights[n] = std::max(heights[n], m_altitude.get(nextX, nextY));
+        }
+
+        // a local peak of altitude starts a new region
+        if (numNeighbours == 0)
+        {
+            regionId[index] = (int)parent.size();
+            parent.push_back((int)parent.size());
+            numTiles.push_back(1);
+            highest.push_back(alt);
+            highestTile.push_back(index);
+            continue;
+        }
+
+        // join the region most of the neighbours are in, on a tie the one reaching higher so that
+        // a region can't creep along the low tiles at the foot of a wall into its neighbour
+        size_t main = 0;
+        for (size_t n=1; n<numNeighbours; ++n)
+        {
+            if (counts[n] > counts[main] || (counts[n] == counts[main] && heights[n] > heights[main]))
+            {
+                main = n;
+            }
+        }
+
+        regionId[index] = neighbours[main];
+        numTiles[neighbours[main]]++;
+
+        // this tile is where the other regions meet the main one
+        for (size_t n=0; n<numNeighbours; ++n)
+        {
+            int a = findRoot(parent, neighbours[main]);
+            int b = findRoot(parent, neighbours[n]);
+            if (a == b)
+            {
+                continue;
+            }
+
+            int smaller = numTiles[a] < numTiles[b] ? a : b;
+            int bigger = smaller == a ? b : a;
+
+            bool merge = numTiles[smaller] < MinRegionTiles
+                || highest[smaller] < MinRegionAltitude
+                || alt * 100 >= highest[smaller] * MergeAltitudePercent
+                || alt * 100 >= highest[bigger] * MergeAltitudePercent;
+
+            if (merge)
+            {
+                parent[smaller] = bigger;
+                numTiles[bigger] += numTiles[smaller];
+
+                if (highest[smaller] > highest[bigger])
+                {
+                    highest[bigger] = highest[smaller];
+                    highestTile[bigger] = highestTile[smaller];
+                }
+            }
+            else
+            {
+                frontier.push_back({ (int)index, a, b });
+            }
+        }
+    }
+
+    // give every remaining root a final region index
+    std::vector<int> finalId(parent.size(), -1);
+    for (size_t i=0; i<parent.size(); ++i)
+    {
+        if (findRoot(parent, (int)i) != (int)i)
+        {
+            continue;
+        }
+
+        finalId[i] = (int)m_regions.size();
+        m_regions.emplace_back();
+
+        Region & region = m_regions.back();
+        region.m_id = finalId[i];
+        region.m_altitude = highest[i] / AltitudeStraightCost;
+        region.m_center = CCTilePosition(highestTile[i] % m_width, highestTile[i] / m_width);
+    }
+
+    for (uint32_t index : order)
+    {
+        regionId[index] = finalId[findRoot(parent, regionId[index])];
+        m_regions[regionId[index]].m_numTiles++;
+    }
+
+    // collect the frontier tiles between every pair of regions that are still apart
+    std::map<std::pair<int, int>, std::vector<int>> frontierTiles;
+    for (auto & f : frontier)
+    {
+        int a = finalId[findRoot(parent, f[1])];
+        int b = finalId[findRoot(parent, f[2])];
+        if (a != b)
+        {
+            frontierTiles[std::make_pair(std::min(a, b), std::max(a, b))].push_back(f[0]);
+        }
+    }
+
+    // the frontier between two regions can be several separate passages, each is its own chokepoint
+    TileGrid<int> mark(m_width, m_height, -1);
+    std::vector<int> group;
+    int pairNumber = 0;
+
+    for (auto & pair : frontierTiles)
+    {
+        std::vector<int> & tiles = pair.second;
+        std::sort(tiles.begin(), tiles.end());
+        tiles.erase(std::unique(tiles.begin(), tiles.end()), tiles.end());
+
+        for (int tile : tiles)
+        {
+            mark.data()[tile] = pairNumber;
+        }
+
+        for (int tile : tiles)
+        {
+            if (mark.data()[tile] != pairNumber)
+            {
+                continue;
+            }
+
+            // gather the frontier tiles touching this one, diagonals included
+            group.clear();
+            group.push_back(tile);
+            mark.data()[tile] = -1;
+
+            for (size_t g=0; g<group.size(); ++g)
+            {
+                int gx = group[g] % m_width;
+                int gy = group[g] / m_width;
+
+                for (int dy=-1; dy<=1; ++dy)
+                {
+                    for (int dx=-1; dx<=1; ++dx)
+                    {
+                        if (mark.at(gx + dx, gy + dy, -1) == pairNumber)
+                        {
+                            mark.set(gx + dx, gy + dy, -1);
+                            group.push_back((int)mark.index(gx + dx, gy + dy));
+                        }
+                    }
+                }
+            }
+
+            Chokepoint choke;
+            choke.m_id = (int)m_chokepoints.size();
+            choke.m_regionA = &m_regions[pair.first.first];
+            choke.m_regionB = &m_regions[pair.first.second];
+
+            // the center is the most open tile of the passage, the sides are its two furthest apart tiles
+            int centerTile = group[0];
+            int sideA = group[0];
+            int sideB = group[0];
+            int widest = 0;
+
+            for (size_t i=0; i<group.size(); ++i)
+            {
+                if (altitude[group[i]] > altitude[centerTile])
+                {
+                    centerTile = group[i];
+                }
+
+                for (size_t j=i+1; j<group.size(); ++j)
+                {
+                    int dx = group[i] % m_width - group[j] % m_width;
+                    int dy = group[i] / m_width - group[j] / m_width;
+                    if (dx*dx + dy*dy > widest)
+                    {
+                        widest = dx*dx + dy*dy;
+                        sideA = group[i];
+                        sideB = group[j];
+                    }
+                }
+
+                choke.m_tiles.push_back(CCTilePosition(group[i] % m_width, group[i] / m_width));
+            }
+
+            // every frontier tile is walkable, so a passage of one tile is one tile wide
+            choke.m_center = CCTilePosition(centerTile % m_width, centerTile / m_width);
+            choke.m_sideA = CCTilePosition(sideA % m_width, sideA / m_width);
+            choke.m_sideB = CCTilePosition(sideB % m_width, sideB / m_width);
+            choke.m_width = std::sqrt((float)widest) + 1.0f;
+
+            m_chokepoints.push_back(choke);
+        }
+
+        pairNumber++;
+    }
+
+    // link the regions to their chokepoints and neighbours, now that neither vector moves anymore
+    for (const Chokepoint & choke : m_chokepoints)
+    {
+        Region & a = m_regions[choke.m_regionA->m_id];
+        Region & b = m_regions[choke.m_regionB->m_id];
+
+        a.m_chokepoints.push_back(&choke);
+        b.m_chokepoints.push_back(&choke);
+
+        if (!a.isNeighbour(&b))
+        {
+            a.m_neighbours.push_back(&b);
+            b.m_neighbours.push_back(&a);
+        }
+    }
+}
+
+const std::vector<Region> & RegionMap::getRegions() const
+{
+    return m_regions;
+}
+
+const std::vector<Chokepoint> & RegionMap::getChokepoints() const
+{
+    return m_chokepoints;
+}
+
+const Region * RegionMap::getRegion(int tileX, int tileY) const
+{
+    int id = m_regionId.at(tileX, tileY, -1);
+    return id < 0 ? nullptr : &m_regions[id];
+}
+
+float RegionMap::getAltitude(int tileX, int tileY) const
+{
+    return (float)m_altitude.at(tileX, tileY, 0) / AltitudeStraightCost;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Common.h"
+#include "Region.h"
+#include "TileGrid.h"
+#include <vector>
+
+class MapTools;
+
+// Splits the walkable map into regions connected by chokepoints, in the style of BWEM.
+//
+// Every walkable tile gets an altitude, its distance to the closest unwalkable tile.
+// The tiles are then visited from the highest altitude down, so regions grow outwards
+// from the most open spots of the map. Where two growing regions meet at a tile that
+// is clearly lower than both of them, the meeting tiles become a chokepoint, otherwise
+// the two regions are merged.
+//
+// The regions only depend on the terrain, so they are built once in MapTools::onStart.
+// Regions and chokepoints refer to each other by pointer, so the map can't be copied.
+class RegionMap
+{
+    int                         m_width;
+    int                         m_height;
+    TileGrid<int>               m_altitude;     // distance to the closest unwalkable tile, in fifths of a tile
+    TileGrid<int>               m_regionId;     // index into m_regions, -1 for unwalkable tiles
+    std::vector<Region>         m_regions;
+    std::vector<Chokepoint>     m_chokepoints;
+
+    void computeAltitude(const MapTools & map);
+    void computeRegions(const MapTools & map);
+
+public:
+
+    RegionMap();
+    RegionMap(const RegionMap &) = delete;
+    RegionMap & operator = (const RegionMap &) = delete;
+
+    void build(const MapTools & map);
+    void clear();
+
+    const std::vector<Region> & getRegions() const;
+    const std::vector<Chokepoint> & getChokepoints() const;
+
+    // the region a tile belongs to, nullptr for unwalkable tiles
+    const Region * getRegion(int tileX, int tileY) const;
+
+    // distance in tiles from the tile to the closest unwalkable tile, 0 for unwalkable tiles
+    float getAltitude(int tileX, int tileY) const;
+};
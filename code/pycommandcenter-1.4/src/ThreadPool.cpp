@@ -0,0 +1,139 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+// one call of parallelFor, shared by the threads working on it
+struct ThreadPool::Job
+{
+    const std::function<void(size_t, size_t)> * body;
+    size_t                      count;
+    size_t                      chunkSize;
+    std::atomic<size_t>         next;
+    size_t                      done;       // items finished, guarded by mutex
+    std::exception_ptr          error;      // the first exception thrown by body, guarded by mutex
+    std::atomic<bool>           failed;     // once set the remaining chunks are skipped
+    std::mutex                  mutex;
+    std::condition_variable     finished;
+};
+
+ThreadPool::ThreadPool()
+{
+    // the thread calling parallelFor works as well, so one thread less than there are cores
+    size_t numWorkers = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    for (size_t i=0; i<numWorkers; ++i)
+    {
+        m_workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool & ThreadPool::get()
+{
+    // never destroyed, joining threads while a Python extension is unloaded can hang the interpreter
+    static ThreadPool * pool = new ThreadPool();
+    return *pool;
+}
+
+size_t ThreadPool::getNumThreads() const
+{
+    return m_workers.size() + 1;
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this]() { return !m_queue.empty(); });
+            job = m_queue.front();
+            m_queue.pop();
+        }
+
+        runChunks(*job);
+    }
+}
+
+// a thread that picks up a job after the last chunk was taken finds nothing left and never touches the body,
+// which may already be gone by then. A chunk that throws still counts as finished, so that parallelFor always
+// gets to wait for the others before it passes the exception on.
+void ThreadPool::runChunks(Job & job)
+{
+    while (true)
+    {
+        size_t begin = job.next.fetch_add(job.chunkSize);
+        if (begin >= job.count)
+        {
+            return;
+        }
+
+        size_t end = std::min(begin + job.chunkSize, job.count);
+        std::exception_ptr error;
+        if (!job.failed)
+        {
+            try
+            {
+                (*job.body)(begin, end);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+                job.failed = true;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(job.mutex);
+        if (error && !job.error)
+        {
+            job.error = error;
+        }
+        job.done += end - begin;
+        if (job.done == job.count)
+        {
+            job.finished.notify_all();
+        }
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, size_t chunkSize, const std::function<void(size_t begin, size_t end)> & body)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    auto job = std::make_shared<Job>();
+    job->body = &body;
+    job->count = count;
+    job->chunkSize = std::max<size_t>(chunkSize, 1);
+    job->next = 0;
+    job->done = 0;
+    job->failed = false;
+
+    // no point in waking more workers than there are chunks for them
+    size_t numChunks = (count + job->chunkSize - 1) / job->chunkSize;
+    size_t numHelpers = std::min(numChunks, getNumThreads()) - 1;
+    if (numHelpers > 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (size_t i=0; i<numHelpers; ++i)
+            {
+                m_queue.push(job);
+            }
+        }
+        m_wake.notify_all();
+    }
+
+    // this thread does its share as well, then waits for the chunks the workers are still on
+    runChunks(*job);
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->finished.wait(lock, [&]() { return job->done == job->count; });
+    if (job->error)
+    {
+        std::rethrow_exception(job->error);
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads shared by the whole library, so that splitting a loop over several
+// threads doesn't start and join new threads every time. The workers are started the first time
+// the pool is used and are never joined, they simply end with the process.
+class ThreadPool
+{
+    struct Job;
+
+    std::vector<std::thread>            m_workers;
+    std::queue<std::shared_ptr<Job>>    m_queue;
+    std::mutex                          m_mutex;
+    std::condition_variable             m_wake;
+
+    ThreadPool();
+
+    void workerLoop();
+    static void runChunks(Job & job);
+
+public:
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool & operator=(const ThreadPool &) = delete;
+
+    static ThreadPool & get();
+
+    // the number of threads a loop can be spread over, the calling thread included
+    size_t getNumThreads() const;
+
+    // Calls body(begin, end) on consecutive chunks of at most chunkSize items until all of [0, count) is done,
+    // spread over the workers and the calling thread, and returns once every chunk has finished. Every thread
+    // takes the next chunk nobody has started on yet, so body has to be safe to run on several threads at once.
+    // If body throws, the chunks not started yet are skipped and the first exception is rethrown here once the
+    // chunks already running have finished.
+    void parallelFor(size_t count, size_t chunkSize, const std::function<void(size_t begin, size_t end)> & body);
+};
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+// A width x height grid of per-tile values stored in a single contiguous,
+// row-major buffer. Tile (x, y) lives at index y * width + x, so scanning a
+// row is a linear walk through memory.
+//
+// get/set/operator() are unchecked and are meant for inner loops where the
+// caller already knows the tile is on the map. at() is bounds-checked and
+// returns the given value for tiles outside the grid.
+template <class T>
+class TileGrid
+{
+    int             m_width;
+    int             m_height;
+    std::vector<T>  m_data;
+
+public:
+
+    TileGrid()
+        : m_width(0)
+        , m_height(0)
+    {
+    }
+
+    TileGrid(int width, int height, const T & value = T())
+        : m_width(width)
+        , m_height(height)
+        , m_data((size_t)width * height, value)
+    {
+    }
+
+    void reset(int width, int height, const T & value = T())
+    {
+        m_width = width;
+        m_height = height;
+        m_data.assign((size_t)width * height, value);
+    }
+
+    void fill(const T & value)
+    {
+        std::fill(m_data.begin(), m_data.end(), value);
+    }
+
+    int     width()  const { return m_width; }
+    int     height() const { return m_height; }
+    size_t  size()   const { return m_data.size(); }
+    bool    empty()  const { return m_data.empty(); }
+
+    bool isValid(int x, int y) const
+    {
+        return x >= 0 && y >= 0 && x < m_width && y < m_height;
+    }
+
+    size_t index(int x, int y) const
+    {
+        return (size_t)y * m_width + x;
+    }
+
+    // unchecked accessors
+    const T & get(int x, int y) const       { return m_data[index(x, y)]; }
+    T &       get(int x, int y)             { return m_data[index(x, y)]; }
+    const T & operator()(int x, int y) const { return m_data[index(x, y)]; }
+    T &       operator()(int x, int y)      { return m_data[index(x, y)]; }
+    void      set(int x, int y, const T & value) { m_data[index(x, y)] = value; }
+
+    // bounds-checked accessor
+    T at(int x, int y, const T & outside = T()) const
+    {
+        return isValid(x, y) ? m_data[index(x, y)] : outside;
+    }
+
+    const T * data() const { return m_data.data(); }
+    T *       data()       { return m_data.data(); }
+};
+
+// Booleans are packed 64 tiles to a word, so a whole 200x200 map fits in 5 KB.
+template <>
+class TileGrid<bool>
+{
+    int                     m_width;
+    int                     m_height;
+    std::vector<uint64_t>   m_bits;
+
+    static size_t wordsFor(int width, int height)
+    {
+        return ((size_t)width * height + 63) / 64;
+    }
+
+public:
+
+    TileGrid()
+        : m_width(0)
+        , m_height(0)
+    {
+    }
+
+    TileGrid(int width, int height, bool value = false)
+    {
+        reset(width, height, value);
+    }
+
+    void reset(int width, int height, bool value = false)
+    {
+        m_width = width;
+        m_height = height;
+        m_bits.assign(wordsFor(width, height), 0);
+        fill(value);
+    }
+
+    void fill(bool value)
+    {
+        std::fill(m_bits.begin(), m_bits.end(), value ? ~(uint64_t)0 : 0);
+
+        // keep the padding bits past the last tile clear so counts stay exact
+        size_t used = (size_t)m_width * m_height;
+        if (value && (used % 64) != 0)
+        {
+            m_bits.back() &= ((uint64_t)1 << (used % 64)) - 1;
+        }
+    }
+
+    int     width()  const { return m_width; }
+    int     height() const { return m_height; }
+    size_t  size()   const { return (size_t)m_width * m_height; }
+    bool    empty()  const { return m_bits.empty(); }
+
+    bool isValid(int x, int y) const
+    {
+        return x >= 0 && y >= 0 && x < m_width && y < m_height;
+    }
+
+    size_t index(int x, int y) const
+    {
+        return (size_t)y * m_width + x;
+    }
+
+    // unchecked accessors
+    bool get(int x, int y) const
+    {
+        size_t i = index(x, y);
+        return (m_bits[i >> 6] >> (i & 63)) & 1;
+    }
+
+    bool operator()(int x, int y) const
+    {
+        return get(x, y);
+    }
+
+    void set(int x, int y, bool value)
+    {
+        size_t i = index(x, y);
+        uint64_t mask = (uint64_t)1 << (i & 63);
+        if (value)
+        {
+            m_bits[i >> 6] |= mask;
+        }
+        else
+        {
+            m_bits[i >> 6] &= ~mask;
+        }
+    }
+
+    // bounds-checked accessor
+    bool at(int x, int y, bool outside = false) const
+    {
+        return isValid(x, y) ? get(x, y) : outside;
+    }
+
+    const uint64_t * words() const { return m_bits.data(); }
+    uint64_t *       words()       { return m_bits.data(); }
+    size_t           wordCount() const { return m_bits.size(); }
+};
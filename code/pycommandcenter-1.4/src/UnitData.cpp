@@ -10,15 +10,10 @@ UnitData::UnitData()
 
 void UnitData::updateUnit(const Unit & unit)
 {
-    bool firstSeen = false;
-    const auto & it = m_unitMap.find(unit);
-    if (it == m_unitMap.end())
-    {
-        firstSeen = true;
-        m_unitMap[unit] = UnitInfo();
-    }
+    auto inserted = m_unitMap.emplace(unit, UnitInfo());
+    bool firstSeen = inserted.second;
 
-    UnitInfo & ui   = m_unitMap[unit];
+    UnitInfo & ui   = inserted.first->second;
     ui.unit         = unit;
     ui.player       = unit.getPlayer();
     ui.lastPosition = unit.getPosition();
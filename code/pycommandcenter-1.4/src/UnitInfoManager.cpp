@@ -25,6 +25,7 @@ void UnitInfoManager::onFrame()
 
 void UnitInfoManager::updateUnitInfo()
 {
+	// the lists are refilled in place, so they keep their memory from the last frame
 	for (int i = 0; i < Players::Size; ++i)
 		m_units[i].clear();
 
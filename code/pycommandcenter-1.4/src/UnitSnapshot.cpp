@@ -0,0 +1,59 @@
+#include "UnitSnapshot.h"
+
+size_t UnitSnapshot::size() const
+{
+    return tags.size();
+}
+
+void UnitSnapshot::build(const std::vector<Unit> & units, int snapshotFrame)
+{
+    const size_t n = units.size();
+    frame = snapshotFrame;
+
+    tags.resize(n);
+    unitTypes.resize(n);
+    players.resize(n);
+    x.resize(n);
+    y.resize(n);
+    radius.resize(n);
+    health.resize(n);
+    maxHealth.resize(n);
+    shields.resize(n);
+    maxShields.resize(n);
+    energy.resize(n);
+    maxEnergy.resize(n);
+    buildProgress.resize(n);
+    flags.resize(n);
+
+    for (size_t i=0; i<n; ++i)
+    {
+        const sc2::Unit * unit = units[i].getUnitPtr();
+
+        tags[i]             = unit->tag;
+        unitTypes[i]        = (uint32_t)unit->unit_type;
+        players[i]          = (int32_t)units[i].getPlayer();
+        x[i]                = unit->pos.x;
+        y[i]                = unit->pos.y;
+        radius[i]           = unit->radius;
+        health[i]           = unit->health;
+        maxHealth[i]        = unit->health_max;
+        shields[i]          = unit->shield;
+        maxShields[i]       = unit->shield_max;
+        energy[i]           = unit->energy;
+        maxEnergy[i]        = unit->energy_max;
+        buildProgress[i]    = unit->build_progress;
+
+        uint32_t f = 0;
+        if (unit->is_flying)                            { f |= Flying; }
+        if (unit->is_burrowed)                          { f |= Burrowed; }
+        if (unit->cloak == sc2::Unit::Cloaked)          { f |= Cloaked; }
+        if (unit->is_powered)                           { f |= Powered; }
+        if (unit->orders.empty())                       { f |= Idle; }
+        if (unit->build_progress >= 1.0f)               { f |= Completed; }
+        if (unit->is_blip)                              { f |= Blip; }
+        if (sc2::IsCarryingMinerals(*unit))             { f |= CarryingMinerals; }
+        if (sc2::IsCarryingVespene(*unit))              { f |= CarryingGas; }
+        if (unit->is_alive)                             { f |= Alive; }
+        flags[i] = f;
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Common.h"
+#include "Unit.h"
+#include <vector>
+
+// The units of one frame stored column by column, for code that looks at many units at once
+// instead of asking every Unit for its values one at a time. Row i of every column is unit i
+// of IDABot::GetAllUnits on the frame the snapshot was taken.
+struct UnitSnapshot
+{
+    // the bits of the flags column
+    enum Flag : uint32_t
+    {
+        Flying              = 1u << 0,
+        Burrowed            = 1u << 1,
+        Cloaked             = 1u << 2,
+        Powered             = 1u << 3,
+        Idle                = 1u << 4,
+        Completed           = 1u << 5,
+        Blip                = 1u << 6,
+        CarryingMinerals    = 1u << 7,
+        CarryingGas         = 1u << 8,
+        Alive               = 1u << 9,
+    };
+
+    int                     frame = -1;
+    std::vector<uint64_t>   tags;
+    std::vector<uint32_t>   unitTypes;
+    std::vector<int32_t>    players;        // Players::Self, Players::Enemy and so on, like Unit::getPlayer
+    std::vector<float>      x;
+    std::vector<float>      y;
+    std::vector<float>      radius;
+    std::vector<float>      health;
+    std::vector<float>      maxHealth;
+    std::vector<float>      shields;
+    std::vector<float>      maxShields;
+    std::vector<float>      energy;
+    std::vector<float>      maxEnergy;
+    std::vector<float>      buildProgress;
+    std::vector<uint32_t>   flags;
+
+    size_t size() const;
+
+    // fills every column from the units, reusing the memory of the columns
+    void build(const std::vector<Unit> & units, int frame);
+};
@@ -0,0 +1,375 @@
+#include "UnitSpatialIndex.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+// the distances to the units of a cell are computed this many at a time, in a loop the compiler can vectorize
+const uint32_t DistanceChunkSize = 32;
+
+// a batch of nearest unit searches hands the units to the threads this many at a time
+const size_t UnitsPerChunk = 64;
+
+constexpr float UnitSpatialIndex::DefaultCellSize;
+
+UnitFilter::UnitFilter(int player, UnitLayer layer, const UnitType & type)
+    : player(player)
+    , layer(layer)
+    , type(type)
+{
+
+}
+
+UnitSpatialIndex::UnitSpatialIndex()
+    : m_cellSize(DefaultCellSize)
+    , m_columns(0)
+    , m_rows(0)
+{
+
+}
+
+void UnitSpatialIndex::clear()
+{
+    m_columns = 0;
+    m_rows = 0;
+    m_cellStart.clear();
+    m_sourceIndex.clear();
+    m_slots.clear();
+    m_units.clear();
+    m_x.clear();
+    m_y.clear();
+    m_players.clear();
+    m_flying.clear();
+    m_radius.clear();
+}
+
+void UnitSpatialIndex::build(const std::vector<Unit> & units, int mapWidth, int mapHeight, float cellSize)
+{
+    BOT_ASSERT(cellSize > 0, "Cell size has to be positive");
+
+    // one cell more than the map needs, so that units standing on its far edge still fall inside the grid
+    m_cellSize = cellSize;
+    m_columns = (int)(std::max(mapWidth, 0) / cellSize) + 1;
+    m_rows = (int)(std::max(mapHeight, 0) / cellSize) + 1;
+
+    // counting sort of the units by cell
+    std::vector<uint32_t> cells(units.size());
+    m_cellStart.assign((size_t)m_columns * m_rows + 1, 0);
+
+    for (size_t i=0; i<units.size(); ++i)
+    {
+        const CCPosition pos = units[i].getPosition();
+        cells[i] = (uint32_t)(getRow(pos.y) * m_columns + getColumn(pos.x));
+        m_cellStart[cells[i] + 1]++;
+    }
+
+    for (size_t c=1; c<m_cellStart.size(); ++c)
+    {
+        m_cellStart[c] += m_cellStart[c - 1];
+    }
+
+    m_sourceIndex.resize(units.size());
+    m_slots.resize(units.size());
+    m_units.resize(units.size());
+    m_x.resize(units.size());
+    m_y.resize(units.size());
+    m_players.resize(units.size());
+    m_flying.resize(units.size());
+    m_radius.resize(units.size());
+
+    std::vector<uint32_t> next(m_cellStart.begin(), m_cellStart.end() - 1);
+    for (size_t i=0; i<units.size(); ++i)
+    {
+        const uint32_t slot = next[cells[i]]++;
+        const CCPosition pos = units[i].getPosition();
+
+        m_sourceIndex[slot] = (uint32_t)i;
+        m_slots[i] = slot;
+        m_units[slot] = units[i];
+        m_x[slot] = pos.x;
+        m_y[slot] = pos.y;
+        m_players[slot] = (int)units[i].getPlayer();
+        m_flying[slot] = units[i].isFlying() ? 1 : 0;
+        m_radius[slot] = units[i].getRadius();
+    }
+}
+
+size_t UnitSpatialIndex::size() const
+{
+    return m_units.size();
+}
+
+const Unit & UnitSpatialIndex::getUnit(size_t i) const
+{
+    return m_units[m_slots[i]];
+}
+
+const CCPosition UnitSpatialIndex::getPosition(size_t i) const
+{
+    return CCPosition(m_x[m_slots[i]], m_y[m_slots[i]]);
+}
+
+int UnitSpatialIndex::getColumn(float x) const
+{
+    return std::min(std::max((int)std::floor(x / m_cellSize), 0), m_columns - 1);
+}
+
+int UnitSpatialIndex::getRow(float y) const
+{
+    return std::min(std::max((int)std::floor(y / m_cellSize), 0), m_rows - 1);
+}
+
+bool UnitSpatialIndex::passes(uint32_t i, const UnitFilter & filter) const
+{
+    if (filter.player != UnitFilter::AnyPlayer && m_players[i] != filter.player)
+    {
+        return false;
+    }
+
+    if ((filter.layer == UnitLayer::Ground && m_flying[i]) || (filter.layer == UnitLayer::Air && !m_flying[i]))
+    {
+        return false;
+    }
+
+    return !filter.type.isValid() || m_units[i].getType() == filter.type;
+}
+
+std::vector<Unit> UnitSpatialIndex::getUnitsInRadius(const CCPosition & center, float radius, const UnitFilter & filter) const
+{
+    std::vector<Unit> units;
+    if (m_units.empty() || radius < 0)
+    {
+        return units;
+    }
+
+    const float radiusSq = radius * radius;
+    const int x1 = getColumn(center.x - radius), x2 = getColumn(center.x + radius);
+    const int y1 = getRow(center.y - radius), y2 = getRow(center.y + radius);
+
+    for (int y=y1; y<=y2; ++y)
+    {
+        for (int x=x1; x<=x2; ++x)
+        {
+            const size_t cell = (size_t)y * m_columns + x;
+            for (uint32_t i=m_cellStart[cell]; i<m_cellStart[cell + 1]; ++i)
+            {
+                const float dx = m_x[i] - center.x;
+                const float dy = m_y[i] - center.y;
+                if (dx*dx + dy*dy <= radiusSq && passes(i, filter))
+                {
+                    units.push_back(m_units[i]);
+                }
+            }
+        }
+    }
+
+    return units;
+}
+
+std::vector<Unit> UnitSpatialIndex::getUnitsInRectangle(const CCPosition & bottomLeft, const CCPosition & topRight, const UnitFilter & filter) const
+{
+    std::vector<Unit> units;
+    if (m_units.empty() || bottomLeft.x > topRight.x || bottomLeft.y > topRight.y)
+    {
+        return units;
+    }
+
+    const int x1 = getColumn(bottomLeft.x), x2 = getColumn(topRight.x);
+    const int y1 = getRow(bottomLeft.y), y2 = getRow(topRight.y);
+
+    for (int y=y1; y<=y2; ++y)
+    {
+        for (int x=x1; x<=x2; ++x)
+        {
+            const size_t cell = (size_t)y * m_columns + x;
+            for (uint32_t i=m_cellStart[cell]; i<m_cellStart[cell + 1]; ++i)
+            {
+                if (m_x[i] >= bottomLeft.x && m_x[i] <= topRight.x && m_y[i] >= bottomLeft.y && m_y[i] <= topRight.y && passes(i, filter))
+                {
+                    units.push_back(m_units[i]);
+                }
+            }
+        }
+    }
+
+    return units;
+}
+
+std::vector<Unit> UnitSpatialIndex::getNearestUnits(const CCPosition & center, size_t k, const UnitFilter & filter, float maxDistance) const
+{
+    std::vector<std::pair<float, uint32_t>> nearest;
+    findNearest(center, k, filter, maxDistance, nearest);
+
+    std::vector<Unit> units;
+    units.reserve(nearest.size());
+    for (auto & n : nearest)
+    {
+        units.push_back(getUnit(n.second));
+    }
+
+    return units;
+}
+
+void UnitSpatialIndex::findNearest(const CCPosition & center, size_t k, const UnitFilter & filter, float maxDistance, std::vector<std::pair<float, uint32_t>> & nearest) const
+{
+    nearest.clear();
+    if (m_units.empty() || k == 0 || maxDistance < 0)
+    {
+        return;
+    }
+
+    const float maxDistanceSq = maxDistance * maxDistance;
+
+    // the search walks rings of cells around the cell of the center, measured from the center moved inside the grid,
+    // which can be closer to a unit than the real center by at most the distance it was moved
+    const float gridX = std::min(std::max(center.x, 0.0f), m_columns * m_cellSize);
+    const float gridY = std::min(std::max(center.y, 0.0f), m_rows * m_cellSize);
+    const float moved = std::sqrt((center.x - gridX) * (center.x - gridX) + (center.y - gridY) * (center.y - gridY));
+    const int cx = getColumn(gridX);
+    const int cy = getRow(gridY);
+    const int rings = std::max(m_columns, m_rows);
+
+    // a max-heap of the k closest units found so far, by squared distance
+    auto visitCell = [&](int x, int y)
+    {
+        if (x < 0 || y < 0 || x >= m_columns || y >= m_rows)
+        {
+            return;
+        }
+
+        const size_t cell = (size_t)y * m_columns + x;
+        for (uint32_t begin=m_cellStart[cell]; begin<m_cellStart[cell + 1]; begin+=DistanceChunkSize)
+        {
+            const uint32_t count = std::min(DistanceChunkSize, m_cellStart[cell + 1] - begin);
+            const float * xs = &m_x[begin];
+            const float * ys = &m_y[begin];
+
+            float distSq[DistanceChunkSize];
+            for (uint32_t j=0; j<count; ++j)
+            {
+                const float dx = xs[j] - center.x;
+                const float dy = ys[j] - center.y;
+                distSq[j] = dx*dx + dy*dy;
+            }
+
+            for (uint32_t j=0; j<count; ++j)
+            {
+                const uint32_t i = begin + j;
+                if (distSq[j] > maxDistanceSq || (nearest.size() == k && distSq[j] >= nearest.front().first) || !passes(i, filter))
+                {
+                    continue;
+                }
+
+                if (nearest.size() == k)
+                {
+                    std::pop_heap(nearest.begin(), nearest.end());
+                    nearest.pop_back();
+                }
+                nearest.push_back(std::make_pair(distSq[j], i));
+                std::push_heap(nearest.begin(), nearest.end());
+            }
+        }
+    };
+
+    for (int r=0; r<=rings; ++r)
+    {
+        if (r > 0)
+        {
+            // every unit in ring r is outside the square of cells of the rings before it
+            float inside = std::min(std::min(gridX - (cx - r + 1) * m_cellSize, (cx + r) * m_cellSize - gridX),
+                                    std::min(gridY - (cy - r + 1) * m_cellSize, (cy + r) * m_cellSize - gridY));
+            float bound = std::max(inside - moved, 0.0f);
+            float limit = nearest.size() == k ? nearest.front().first : maxDistanceSq;
+
+            if (bound * bound > limit)
+            {
+                break;
+            }
+        }
+
+        if (r == 0)
+        {
+            visitCell(cx, cy);
+            continue;
+        }
+
+        for (int x=cx-r; x<=cx+r; ++x)
+        {
+            visitCell(x, cy - r);
+            visitCell(x, cy + r);
+        }
+
+        for (int y=cy-r+1; y<=cy+r-1; ++y)
+        {
+            visitCell(cx - r, y);
+            visitCell(cx + r, y);
+        }
+    }
+
+    std::sort_heap(nearest.begin(), nearest.end());
+    for (auto & n : nearest)
+    {
+        n.first = std::sqrt(n.first);
+        n.second = m_sourceIndex[n.second];
+    }
+}
+
+void UnitSpatialIndex::findNearestForUnits(const std::vector<Unit> & units, size_t k, const UnitFilter & filter, float maxDistance, NearestUnits & result) const
+{
+    // the weapon ranges come from the game data, so they are looked up here once per type instead of on the workers,
+    // a unit can only reach a target with the weapons that hit the target's layer
+    std::vector<CCPosition> centers(units.size());
+    std::vector<float> groundReach(units.size());
+    std::vector<float> airReach(units.size());
+    std::map<UnitType, std::pair<float, float>> ranges;
+
+    for (size_t u=0; u<units.size(); ++u)
+    {
+        const UnitType & type = units[u].getType();
+        auto range = ranges.find(type);
+        if (range == ranges.end())
+        {
+            range = ranges.insert(std::make_pair(type, std::make_pair((float)type.getGroundAttackRange(), (float)type.getAirAttackRange()))).first;
+        }
+
+        // a unit without any weapon for a layer can't reach units there, however close
+        float radius = units[u].getRadius();
+        centers[u] = units[u].getPosition();
+        groundReach[u] = range->second.first > 0.0f ? range->second.first + radius : -1.0f;
+        airReach[u] = range->second.second > 0.0f ? range->second.second + radius : -1.0f;
+    }
+
+    findNearestForPositions(centers, groundReach, airReach, k, filter, maxDistance, result);
+}
+
+void UnitSpatialIndex::findNearestForPositions(const std::vector<CCPosition> & centers, const std::vector<float> & groundReach, const std::vector<float> & airReach,
+                                               size_t k, const UnitFilter & filter, float maxDistance, NearestUnits & result) const
+{
+    BOT_ASSERT(groundReach.size() == centers.size() && airReach.size() == centers.size(), "Every center needs a ground and air reach");
+
+    result.rows = centers.size();
+    result.k = k;
+    result.indices.assign(centers.size() * k, -1);
+    result.distances.assign(centers.size() * k, std::numeric_limits<float>::infinity());
+    result.inRange.assign(centers.size() * k, 0);
+
+    // each center only writes its own row
+    ThreadPool::get().parallelFor(centers.size(), UnitsPerChunk, [&](size_t begin, size_t end)
+    {
+        std::vector<std::pair<float, uint32_t>> nearest;
+        for (size_t u=begin; u<end; ++u)
+        {
+            findNearest(centers[u], k, filter, maxDistance, nearest);
+            for (size_t n=0; n<nearest.size(); ++n)
+            {
+                const size_t slot = u * k + n;
+                const uint32_t target = m_slots[nearest[n].second];
+                const float reach = m_flying[target] ? airReach[u] : groundReach[u];
+                result.indices[slot] = (int32_t)nearest[n].second;
+                result.distances[slot] = nearest[n].first;
+                result.inRange[slot] = reach >= 0.0f && nearest[n].first <= reach + m_radius[target] ? 1 : 0;
+            }
+        }
+    });
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "Common.h"
+#include "Unit.h"
+#include "UnitType.h"
+#include <limits>
+#include <vector>
+
+enum class UnitLayer
+{
+    Any,
+    Ground,     // units that aren't flying, buildings included
+    Air
+};
+
+// which units a query of UnitSpatialIndex returns, by default every unit
+struct UnitFilter
+{
+    static const int AnyPlayer = -1;
+
+    int         player = AnyPlayer;     // one of Players, or AnyPlayer
+    UnitLayer   layer = UnitLayer::Any;
+    UnitType    type;                   // an invalid type lets every type through
+
+    UnitFilter() {}
+    UnitFilter(int player, UnitLayer layer = UnitLayer::Any, const UnitType & type = UnitType());
+};
+
+// the result of UnitSpatialIndex::findNearestForUnits, row i belongs to the i:th unit and holds its k closest units,
+// closest first, rows with fewer than k units are padded with an index of -1 and an infinite distance
+struct NearestUnits
+{
+    size_t                  rows = 0;
+    size_t                  k = 0;
+    std::vector<int32_t>    indices;        // positions in the list the index was built from, see UnitSpatialIndex::getUnit
+    std::vector<float>      distances;      // between the centers of the units
+    std::vector<uint8_t>    inRange;        // whether the unit of the row can reach the other unit with its longest weapon that hits the other unit's layer
+};
+
+// A uniform grid over the units of one frame, so that finding the units near a point only has to look
+// at the few cells around it instead of every unit. The units are stored sorted by cell, with their
+// positions, players and layers in arrays of their own so that the queries mostly read packed floats.
+class UnitSpatialIndex
+{
+    float                   m_cellSize;
+    int                     m_columns;
+    int                     m_rows;
+
+    std::vector<uint32_t>   m_cellStart;        // the units of cell c are [m_cellStart[c], m_cellStart[c+1])
+    std::vector<uint32_t>   m_sourceIndex;      // where the unit of every slot was in the list given to build
+    std::vector<uint32_t>   m_slots;            // the other way around, the slot of every unit of that list
+    std::vector<Unit>       m_units;
+    std::vector<float>      m_x;
+    std::vector<float>      m_y;
+    std::vector<int>        m_players;
+    std::vector<uint8_t>    m_flying;
+    std::vector<float>      m_radius;
+
+    int     getColumn(float x) const;
+    int     getRow(float y) const;
+    bool    passes(uint32_t i, const UnitFilter & filter) const;
+
+public:
+
+    static constexpr float DefaultCellSize = 8.0f;
+
+    UnitSpatialIndex();
+
+    // puts the units in a grid covering a map of the given size, units outside the map go in the border cells
+    void build(const std::vector<Unit> & units, int mapWidth, int mapHeight, float cellSize = DefaultCellSize);
+    void clear();
+
+    // the units are numbered as in the list given to build, which lets the results be matched with
+    // IDABot::GetAllUnits and the columns of a UnitSnapshot of the same frame
+    size_t size() const;
+    const Unit & getUnit(size_t i) const;
+    const CCPosition getPosition(size_t i) const;
+
+    // the units at most radius away from center, in no particular order
+    std::vector<Unit> getUnitsInRadius(const CCPosition & center, float radius, const UnitFilter & filter = UnitFilter()) const;
+
+    // the units with bottomLeft.x <= x <= topRight.x and bottomLeft.y <= y <= topRight.y, in no particular order
+    std::vector<Unit> getUnitsInRectangle(const CCPosition & bottomLeft, const CCPosition & topRight, const UnitFilter & filter = UnitFilter()) const;
+
+    // the k units closest to center, closest first, only counting units at most maxDistance away
+    std::vector<Unit> getNearestUnits(const CCPosition & center, size_t k, const UnitFilter & filter = UnitFilter(), float maxDistance = std::numeric_limits<float>::max()) const;
+
+    // like getNearestUnits, but replaces the contents of nearest with (distance, index of the unit) pairs,
+    // safe to call from several threads at once
+    void findNearest(const CCPosition & center, size_t k, const UnitFilter & filter, float maxDistance, std::vector<std::pair<float, uint32_t>> & nearest) const;
+
+    // findNearest for every one of the units at once, spread over several threads when there are many of them
+    void findNearestForUnits(const std::vector<Unit> & units, size_t k, const UnitFilter & filter, float maxDistance, NearestUnits & result) const;
+
+    // findNearestForUnits for points that reach as far as the given distances from their centers to the edge of ground
+    // and air units, a negative distance means nothing on that layer is ever in range
+    void findNearestForPositions(const std::vector<CCPosition> & centers, const std::vector<float> & groundReach, const std::vector<float> & airReach,
+                                 size_t k, const UnitFilter & filter, float maxDistance, NearestUnits & result) const;
+};
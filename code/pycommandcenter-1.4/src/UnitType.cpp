@@ -296,6 +296,42 @@ CCPositionType UnitType::getAttackRange() const
 #endif
 }
 
+CCPositionType UnitType::getGroundAttackRange() const
+{
+#ifdef SC2API
+    float maxRange = 0.0f;
+    for (auto & weapon : m_client->Observation()->GetUnitTypeData()[m_type].weapons)
+    {
+        if ((weapon.type == sc2::Weapon::TargetType::Ground || weapon.type == sc2::Weapon::TargetType::Any) && weapon.range > maxRange)
+        {
+            maxRange = weapon.range;
+        }
+    }
+
+    return maxRange;
+#else
+    return m_type.groundWeapon().maxRange();
+#endif
+}
+
+CCPositionType UnitType::getAirAttackRange() const
+{
+#ifdef SC2API
+    float maxRange = 0.0f;
+    for (auto & weapon : m_client->Observation()->GetUnitTypeData()[m_type].weapons)
+    {
+        if ((weapon.type == sc2::Weapon::TargetType::Air || weapon.type == sc2::Weapon::TargetType::Any) && weapon.range > maxRange)
+        {
+            maxRange = weapon.range;
+        }
+    }
+
+    return maxRange;
+#else
+    return m_type.airWeapon().maxRange();
+#endif
+}
+
 float UnitType::getAttackDamage() const
 {
 #ifdef SC2API
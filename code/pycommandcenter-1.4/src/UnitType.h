@@ -52,6 +52,9 @@ public:
 	bool canAttackGound() const;
 	bool canAttackAir() const;
     CCPositionType getAttackRange() const;
+    // the longest range of the weapons that can hit ground or air units, 0 if there is none
+    CCPositionType getGroundAttackRange() const;
+    CCPositionType getAirAttackRange() const;
 	float getAttackDamage() const;
     int tileWidth() const;
     int tileHeight() const;
@@ -0,0 +1,139 @@
+// Compares the answers of UnitSpatialIndex with a brute force search over the same units,
+// it doesn't need a running game and returns a non-zero exit code on any difference.
+#include "UnitSpatialIndex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool ok, const char * what, size_t row)
+    {
+        if (!ok)
+        {
+            failures++;
+            std::printf("FAILED: %s (row %zu)\n", what, row);
+        }
+    }
+
+    float distance(const CCPosition & a, const CCPosition & b)
+    {
+        return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+    }
+
+    // the distances to every unit of the player, closest first, capped at maxDistance
+    std::vector<std::pair<float, size_t>> bruteForce(const std::vector<Unit> & units, const CCPosition & center, int player, float maxDistance)
+    {
+        std::vector<std::pair<float, size_t>> found;
+        for (size_t i=0; i<units.size(); ++i)
+        {
+            float dist = distance(units[i].getPosition(), center);
+            if ((player == UnitFilter::AnyPlayer || units[i].getPlayer() == player) && dist <= maxDistance)
+            {
+                found.push_back(std::make_pair(dist, i));
+            }
+        }
+
+        std::sort(found.begin(), found.end());
+        return found;
+    }
+}
+
+int main()
+{
+    const int mapSize = 150;
+    const size_t k = 4;
+    const float maxDistance = 30.0f;
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> coordinate(-5.0f, mapSize + 5.0f);
+    std::uniform_real_distribution<float> size(0.25f, 2.0f);
+
+    // units on and just outside the map, some of them flying, for three players
+    std::vector<sc2::Unit> raw(2000);
+    const sc2::Unit::Alliance alliances[] = { sc2::Unit::Alliance::Self, sc2::Unit::Alliance::Enemy, sc2::Unit::Alliance::Neutral };
+    for (size_t i=0; i<raw.size(); ++i)
+    {
+        raw[i].tag = i + 1;
+        raw[i].pos = sc2::Point3D(coordinate(rng), coordinate(rng), 0.0f);
+        raw[i].alliance = alliances[i % 3];
+        raw[i].is_flying = i % 5 == 0;
+        raw[i].radius = size(rng);
+    }
+
+    std::vector<Unit> units;
+    for (auto & unit : raw)
+    {
+        units.push_back(Unit(&unit));
+    }
+
+    UnitSpatialIndex index;
+    index.build(units, mapSize, mapSize);
+    check(index.size() == units.size(), "size", 0);
+
+    // the index numbers the units as they were given to build
+    for (size_t i=0; i<units.size(); ++i)
+    {
+        check(index.getUnit(i).getID() == units[i].getID(), "getUnit", i);
+    }
+
+    // every unit looks for the k closest enemies, ground units reach 5 and air units 3 beyond their radius
+    std::vector<CCPosition> centers;
+    std::vector<float> groundReach;
+    std::vector<float> airReach;
+    for (auto & unit : units)
+    {
+        centers.push_back(unit.getPosition());
+        groundReach.push_back(5.0f + unit.getRadius());
+        airReach.push_back(3.0f + unit.getRadius());
+    }
+
+    NearestUnits result;
+    index.findNearestForPositions(centers, groundReach, airReach, k, UnitFilter(Players::Enemy), maxDistance, result);
+    check(result.rows == units.size() && result.k == k, "result shape", 0);
+
+    for (size_t u=0; u<units.size(); ++u)
+    {
+        auto expected = bruteForce(units, centers[u], Players::Enemy, maxDistance);
+        for (size_t n=0; n<k; ++n)
+        {
+            const size_t slot = u * k + n;
+            if (n >= expected.size())
+            {
+                check(result.indices[slot] == -1, "padding", u);
+                continue;
+            }
+
+            // ties may come in another order, so the distances are compared and the index has to have the same distance
+            check(std::fabs(result.distances[slot] - expected[n].first) < 1e-3f, "distance", u);
+            check(result.indices[slot] >= 0 && (size_t)result.indices[slot] < units.size(), "index", u);
+            if (result.indices[slot] < 0)
+            {
+                continue;
+            }
+
+            const Unit & target = units[result.indices[slot]];
+            check(std::fabs(distance(target.getPosition(), centers[u]) - result.distances[slot]) < 1e-3f, "index matches distance", u);
+
+            bool inRange = result.distances[slot] <= (target.isFlying() ? airReach[u] : groundReach[u]) + target.getRadius();
+            check(inRange == (result.inRange[slot] != 0), "in range", u);
+        }
+
+        // the radius query finds exactly the units the brute force finds within 10
+        auto inRadius = index.getUnitsInRadius(centers[u], 10.0f);
+        check(inRadius.size() == bruteForce(units, centers[u], UnitFilter::AnyPlayer, 10.0f).size(), "radius", u);
+    }
+
+    if (failures > 0)
+    {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    std::printf("all checks passed\n");
+    return 0;
+}